@@ -0,0 +1,137 @@
+#include "adc_snapshot.h"
+#include "hid_reports.h"
+#include "hid_queue.h"
+#include "usb_descriptors.h"
+#include "tusb.h"
+#include "pico/time.h"
+#include <string.h>
+
+static bool enabled = false;
+static uint8_t interval_ms = 0;
+static uint8_t mask[ADC_SNAPSHOT_MASK_BYTES];
+static uint8_t key_list[SENSOR_COUNT];   // subscribed sensor indices, ascending
+static uint8_t key_count = 0;
+
+// Pending snapshot
+static uint16_t frame[SENSOR_COUNT];
+static uint32_t frame_time_us = 0;
+static uint16_t frame_seq = 0;
+static uint8_t next_part = 0;
+static uint8_t part_count = 0;           // 0 = nothing pending
+static uint32_t last_capture_us = 0;
+
+static void rebuild_key_list(void)
+{
+    key_count = 0;
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        if (mask[i / 8] & (1u << (i % 8))) key_list[key_count++] = i;
+    }
+}
+
+static void send_next_part(uint8_t instance);
+
+void adc_snapshot_init(void)
+{
+    enabled = false;
+    interval_ms = 0;
+    memset(mask, 0xFF, sizeof(mask));
+    rebuild_key_list();
+    part_count = 0;
+    // Later parts go out from the report-complete callback, one per frame
+    hid_queue_add_idle_handler(ITF_NUM_HID_RESP_RAW, send_next_part);
+}
+
+void adc_snapshot_configure(bool en, uint8_t interval, const uint8_t *m, uint8_t mask_len)
+{
+    memset(mask, 0xFF, sizeof(mask));
+    if (m && mask_len > 0) {
+        if (mask_len > sizeof(mask)) mask_len = sizeof(mask);
+        memset(mask, 0, sizeof(mask));
+        memcpy(mask, m, mask_len);
+    }
+    rebuild_key_list();
+
+    enabled = en && key_count > 0;
+    interval_ms = interval;
+    // Drop a half-sent frame: its layout no longer matches the subscription
+    part_count = 0;
+}
+
+bool adc_snapshot_get_enabled(void) { return enabled; }
+bool adc_snapshot_streaming(void) { return enabled; }
+uint8_t adc_snapshot_get_interval(void) { return interval_ms; }
+uint8_t adc_snapshot_get_key_count(void) { return key_count; }
+
+void adc_snapshot_get_mask(uint8_t *out)
+{
+    if (out) memcpy(out, mask, sizeof(mask));
+}
+
+bool adc_snapshot_wanted(void)
+{
+    if (!enabled || part_count != 0) return false;
+    return (time_us_32() - last_capture_us) >= (uint32_t)interval_ms * 1000u;
+}
+
+void adc_snapshot_capture(const uint16_t *values, uint32_t scan_time_us)
+{
+    for (uint8_t i = 0; i < key_count; i++) {
+        frame[i] = values[key_list[i]] & 0x0FFF;
+    }
+    frame_time_us = scan_time_us;
+    frame_seq++;
+    next_part = 0;
+    part_count = (uint8_t)((key_count + ADC_SNAPSHOT_VALUES_PER_REPORT - 1) / ADC_SNAPSHOT_VALUES_PER_REPORT);
+    last_capture_us = time_us_32();
+}
+
+// Send the next part if the endpoint is free. Runs from the main loop and as
+// the interface's idle handler, so a multi-part snapshot drains at one part
+// per USB frame without waiting for further loop passes.
+static void send_next_part(uint8_t instance)
+{
+    (void)instance;
+    if (part_count == 0) return;
+    if (!tud_mounted()) {
+        part_count = 0;
+        return;
+    }
+    // One part per free endpoint slot; never queue behind command responses
+    if (hid_queue_pending(ITF_NUM_HID_RESP_RAW) || !tud_hid_n_ready(ITF_NUM_HID_RESP_RAW)) return;
+
+    const uint8_t first = (uint8_t)(next_part * ADC_SNAPSHOT_VALUES_PER_REPORT);
+    uint8_t count = (uint8_t)(key_count - first);
+    if (count > ADC_SNAPSHOT_VALUES_PER_REPORT) count = ADC_SNAPSHOT_VALUES_PER_REPORT;
+
+    uint8_t resp[64] = {0};
+    resp[0] = RESP_ADC_SNAPSHOT;
+    resp[1] = (uint8_t)(frame_seq & 0xFF);
+    resp[2] = (uint8_t)(frame_seq >> 8);
+    resp[3] = (uint8_t)(frame_time_us & 0xFF);
+    resp[4] = (uint8_t)((frame_time_us >> 8) & 0xFF);
+    resp[5] = (uint8_t)((frame_time_us >> 16) & 0xFF);
+    resp[6] = (uint8_t)((frame_time_us >> 24) & 0xFF);
+    resp[7] = next_part;
+    resp[8] = part_count;
+    resp[9] = count;
+
+    uint8_t *p = &resp[ADC_SNAPSHOT_HEADER_LEN];
+    for (uint8_t i = 0; i < count; i += 2) {
+        const uint16_t v0 = frame[first + i];
+        const uint16_t v1 = (i + 1 < count) ? frame[first + i + 1] : 0;
+        *p++ = (uint8_t)(v0 & 0xFF);
+        *p++ = (uint8_t)(((v0 >> 8) & 0x0F) | ((v1 & 0x0F) << 4));
+        *p++ = (uint8_t)(v1 >> 4);
+    }
+
+    // Response Raw carries no report ID (matches the other ADC responses)
+    if (!hid_queue_send(ITF_NUM_HID_RESP_RAW, 0, resp, sizeof(resp), HID_QUEUE_FLAG_NONE)) return;
+
+    next_part++;
+    if (next_part >= part_count) part_count = 0;
+}
+
+void adc_snapshot_task(void)
+{
+    send_next_part(ITF_NUM_HID_RESP_RAW);
+}
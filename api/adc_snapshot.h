@@ -0,0 +1,49 @@
+#ifndef ADC_SNAPSHOT_H
+#define ADC_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hallscan_config.h"
+
+// Full-frame ADC streaming for calibration and tuning tools. Raw 12-bit
+// values of the subscribed keys are copied from one scan pass, then sent as
+// consecutive Response Raw reports (one per USB frame while the endpoint is
+// free), refilled from the report-complete callback. A new snapshot is only
+// taken once the previous one is fully out.
+//
+// Report: [RESP_ADC_SNAPSHOT, seq_lo, seq_hi, t0, t1, t2, t3, part, parts, count,
+//          packed values...]
+//   seq    frame sequence number, shared by every part of one snapshot
+//   t      scan timestamp (time_us_32), little-endian
+//   values in ascending key order over the subscription mask, 2 values per
+//          3 bytes: v0[7:0], v0[11:8] | v1[3:0] << 4, v1[11:4]
+
+#define ADC_SNAPSHOT_HEADER_LEN     10
+#define ADC_SNAPSHOT_VALUES_PER_REPORT 36   // (64 - header) / 3 * 2
+#define ADC_SNAPSHOT_MASK_BYTES     ((SENSOR_COUNT + 7) / 8)
+
+void adc_snapshot_init(void);
+
+// interval_ms: minimum time between snapshot starts (0 = as fast as USB allows)
+// mask: one bit per key, LSB first; NULL or mask_len 0 subscribes every key
+void adc_snapshot_configure(bool enabled, uint8_t interval_ms, const uint8_t *mask, uint8_t mask_len);
+
+bool adc_snapshot_get_enabled(void);
+// True while streaming: the main loop then skips its pause between scans so
+// a new snapshot can be captured as soon as the previous one is out
+bool adc_snapshot_streaming(void);
+uint8_t adc_snapshot_get_interval(void);
+uint8_t adc_snapshot_get_key_count(void);
+void adc_snapshot_get_mask(uint8_t *mask);   // ADC_SNAPSHOT_MASK_BYTES
+
+// True when a new snapshot should be captured from the scan that just ran
+bool adc_snapshot_wanted(void);
+
+// Copy the subscribed keys out of one scan pass (indexed by sensor)
+void adc_snapshot_capture(const uint16_t *values, uint32_t scan_time_us);
+
+// Kick the pending snapshot if the endpoint is idle (later parts follow from
+// the report-complete callback)
+void adc_snapshot_task(void);
+
+#endif // ADC_SNAPSHOT_H
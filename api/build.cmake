@@ -16,7 +16,21 @@ set(API_COMMON_SOURCES
     ${API_DIR}/hid_reports.c
     ${API_DIR}/profiles.c
     ${API_DIR}/encoder.c
+    ${API_DIR}/keyboard_report.c
+    ${API_DIR}/hid_queue.c
+    ${API_DIR}/hid_cmd.c
+    ${API_DIR}/adc_snapshot.c
+    ${API_DIR}/raw_tx.c
+    ${API_DIR}/config_image.c
+    ${API_DIR}/sof_align.c
+    ${API_DIR}/latency.c
+    ${API_DIR}/notify.c
+    ${API_DIR}/consumer_report.c
     ${API_DIR}/features/socd/socd.c
+    ${API_DIR}/features/midi/midi.c
+    ${API_DIR}/features/two_stage/two_stage.c
+    ${API_DIR}/features/layer_actuation/layer_actuation.c
+    ${API_DIR}/features/mouse/mouse.c
     ${API_DIR}/lighting/lighting.c
 )
 
@@ -38,16 +52,44 @@ macro(marsvlt_configure_target TARGET_NAME)
         ${API_DIR}
         ${API_DIR}/src/usb
         ${API_DIR}/features/socd
+        ${API_DIR}/features/midi
+        ${API_DIR}/features/two_stage
+        ${API_DIR}/features/layer_actuation
+        ${API_DIR}/features/mouse
         ${API_DIR}/lighting
         ${API_DIR}/drivers
     )
 
+    # Per-key LED geometry for the lighting effects, generated from the
+    # board's KLE layout (boards without layout.json use a built-in row table)
+    if(EXISTS ${BOARD_DIR}/layout.json)
+        find_package(Python3 COMPONENTS Interpreter)
+        if(Python3_Interpreter_FOUND)
+            set(LED_GEOMETRY_DIR ${CMAKE_CURRENT_BINARY_DIR}/generated)
+            add_custom_command(
+                OUTPUT ${LED_GEOMETRY_DIR}/led_geometry.h
+                COMMAND ${CMAKE_COMMAND} -E make_directory ${LED_GEOMETRY_DIR}
+                COMMAND ${Python3_EXECUTABLE} ${API_DIR}/lighting/gen_led_geometry.py
+                        ${BOARD_DIR}/layout.json ${LED_GEOMETRY_DIR}/led_geometry.h
+                DEPENDS ${BOARD_DIR}/layout.json ${API_DIR}/lighting/gen_led_geometry.py
+                COMMENT "Generating LED geometry from layout.json"
+            )
+            target_sources(${TARGET_NAME} PRIVATE ${LED_GEOMETRY_DIR}/led_geometry.h)
+            target_include_directories(${TARGET_NAME} PRIVATE ${LED_GEOMETRY_DIR})
+            target_compile_definitions(${TARGET_NAME} PRIVATE LED_GEOMETRY_GENERATED)
+        else()
+            message(WARNING "Python 3 not found: lighting effects use the built-in key row table")
+        endif()
+    endif()
+
     # Link required Pico SDK libraries
     target_link_libraries(${TARGET_NAME}
         pico_stdlib
         hardware_spi
         hardware_gpio
         hardware_pio
+        hardware_dma
+        pico_multicore
         hardware_flash
         hardware_watchdog
         tinyusb_device
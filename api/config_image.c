@@ -0,0 +1,220 @@
+#include "config_image.h"
+#include "hid_reports.h"
+#include "profiles.h"
+#include <string.h>
+#include <stdio.h>
+
+// Settings block access provided by main.c
+extern size_t settings_export(uint8_t *buf, size_t cap);
+extern bool settings_block_valid(const uint8_t *buf, size_t len);
+extern bool settings_import(const uint8_t *buf, size_t len);
+
+typedef enum {
+    WRITE_IDLE = 0,
+    WRITE_RECEIVING,
+    WRITE_VERIFIED,     // complete and CRC checked, waiting for the main loop
+} write_state_t;
+
+// One buffer serves both directions: a read discards a staged write.
+static uint8_t image[CONFIG_IMAGE_MAX_BYTES];
+static uint32_t image_len = 0;
+static uint32_t image_crc = 0;
+
+static write_state_t write_state = WRITE_IDLE;
+static uint16_t expected_seq = 0;
+static bool read_active = false;   // image is being streamed to the host
+
+static inline void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)((v >> 8) & 0xFF);
+    p[2] = (uint8_t)((v >> 16) & 0xFF);
+    p[3] = (uint8_t)((v >> 24) & 0xFF);
+}
+
+static inline uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// CRC-32 (IEEE 802.3, reflected), nibble table
+uint32_t config_image_crc32(const uint8_t *data, size_t len)
+{
+    static const uint32_t table[16] = {
+        0x00000000u, 0x1DB71064u, 0x3B6E20C8u, 0x26D930ACu,
+        0x76DC4190u, 0x6B6B51F4u, 0x4DB26158u, 0x5005713Cu,
+        0xEDB88320u, 0xF00F9344u, 0xD6D6A3E8u, 0xCB61B38Cu,
+        0x9B64C2B0u, 0x86D3D2D4u, 0xA00AE278u, 0xBDBDF21Cu,
+    };
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void config_image_init(void)
+{
+    image_len = 0;
+    write_state = WRITE_IDLE;
+    expected_seq = 0;
+    read_active = false;
+}
+
+// ---------------------------------------------------------------------------
+// Read
+// ---------------------------------------------------------------------------
+
+// RESP_CONFIG_CHUNK record: [seq_lo, seq_hi, len, data...], cursor = seq
+static bool next_chunk(raw_tx_job_t *job, uint8_t *rec)
+{
+    const uint32_t offset = (uint32_t)job->cursor * CONFIG_IMAGE_CHUNK;
+    if (job->cursor == CONFIG_IMAGE_TRAILER_SEQ) {
+        read_active = false;
+        return false;
+    }
+
+    if (offset >= image_len) {
+        put_u16(&rec[0], CONFIG_IMAGE_TRAILER_SEQ);
+        rec[2] = 0;
+        put_u32(&rec[3], image_len);
+        put_u32(&rec[7], image_crc);
+        job->cursor = CONFIG_IMAGE_TRAILER_SEQ;
+        return true;
+    }
+
+    uint32_t n = image_len - offset;
+    if (n > CONFIG_IMAGE_CHUNK) n = CONFIG_IMAGE_CHUNK;
+    put_u16(&rec[0], job->cursor);
+    rec[2] = (uint8_t)n;
+    memcpy(&rec[3], &image[offset], n);
+    job->cursor++;
+    return true;
+}
+
+bool config_image_read_job(raw_tx_job_t *job)
+{
+    if (read_active) return false;
+    write_state = WRITE_IDLE;
+
+    const size_t settings_len = settings_export(&image[CONFIG_IMAGE_HEADER_LEN],
+                                                sizeof(image) - CONFIG_IMAGE_HEADER_LEN);
+    if (settings_len == 0) return false;
+    const size_t profiles_len = profiles_export(&image[CONFIG_IMAGE_HEADER_LEN + settings_len],
+                                                sizeof(image) - CONFIG_IMAGE_HEADER_LEN - settings_len);
+    if (profiles_len == 0) return false;
+
+    put_u32(&image[0], CONFIG_IMAGE_MAGIC);
+    put_u16(&image[4], CONFIG_IMAGE_FORMAT);
+    put_u16(&image[6], (uint16_t)settings_len);
+    put_u16(&image[8], (uint16_t)profiles_len);
+    put_u16(&image[10], 0);
+
+    image_len = (uint32_t)(CONFIG_IMAGE_HEADER_LEN + settings_len + profiles_len);
+    image_crc = config_image_crc32(image, image_len);
+
+    memset(job, 0, sizeof(*job));
+    job->resp_code = RESP_CONFIG_CHUNK;
+    job->record_len = 3 + CONFIG_IMAGE_CHUNK;
+    job->next = next_chunk;
+    read_active = true;
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Write
+// ---------------------------------------------------------------------------
+
+void config_image_read_abort(void)
+{
+    read_active = false;
+}
+
+config_status_t config_image_write_begin(uint32_t total)
+{
+    if (read_active) return CONFIG_STATUS_BUSY;
+    write_state = WRITE_IDLE;
+    if (total < CONFIG_IMAGE_HEADER_LEN || total > sizeof(image)) return CONFIG_STATUS_BAD_LENGTH;
+    image_len = total;
+    expected_seq = 0;
+    write_state = WRITE_RECEIVING;
+    return CONFIG_STATUS_OK;
+}
+
+config_status_t config_image_write_chunk(uint16_t seq, const uint8_t *data, uint8_t len)
+{
+    if (write_state != WRITE_RECEIVING) return CONFIG_STATUS_NOT_ACTIVE;
+    if (seq != expected_seq) {
+        write_state = WRITE_IDLE;
+        return CONFIG_STATUS_BAD_SEQUENCE;
+    }
+    const uint32_t offset = (uint32_t)seq * CONFIG_IMAGE_CHUNK;
+    // Every chunk but the last is full, so offsets follow from seq alone
+    if (len == 0 || len > CONFIG_IMAGE_CHUNK || offset + len > image_len ||
+        (len < CONFIG_IMAGE_CHUNK && offset + len != image_len)) {
+        write_state = WRITE_IDLE;
+        return CONFIG_STATUS_BAD_LENGTH;
+    }
+    memcpy(&image[offset], data, len);
+    expected_seq++;
+    return CONFIG_STATUS_OK;
+}
+
+config_status_t config_image_write_verify(uint32_t crc)
+{
+    if (write_state != WRITE_RECEIVING) return CONFIG_STATUS_NOT_ACTIVE;
+    write_state = WRITE_IDLE;
+
+    if ((uint32_t)expected_seq * CONFIG_IMAGE_CHUNK < image_len) return CONFIG_STATUS_BAD_LENGTH;
+    if (config_image_crc32(image, image_len) != crc) return CONFIG_STATUS_BAD_CRC;
+
+    if (get_u32(&image[0]) != CONFIG_IMAGE_MAGIC || get_u16(&image[4]) != CONFIG_IMAGE_FORMAT) {
+        return CONFIG_STATUS_BAD_IMAGE;
+    }
+    const uint32_t settings_len = get_u16(&image[6]);
+    const uint32_t profiles_len = get_u16(&image[8]);
+    if (CONFIG_IMAGE_HEADER_LEN + settings_len + profiles_len != image_len) return CONFIG_STATUS_BAD_IMAGE;
+
+    // Check both blocks up front so a commit never writes one and rejects the other
+    const uint8_t *settings = &image[CONFIG_IMAGE_HEADER_LEN];
+    if (!settings_block_valid(settings, settings_len)) return CONFIG_STATUS_BAD_IMAGE;
+    if (!profiles_block_valid(settings + settings_len, profiles_len)) return CONFIG_STATUS_BAD_IMAGE;
+
+    write_state = WRITE_VERIFIED;
+    return CONFIG_STATUS_OK;
+}
+
+config_status_t config_image_commit(void)
+{
+    if (write_state != WRITE_VERIFIED) return CONFIG_STATUS_NOT_ACTIVE;
+    write_state = WRITE_IDLE;
+
+    const uint8_t *settings = &image[CONFIG_IMAGE_HEADER_LEN];
+    const uint32_t settings_len = get_u16(&image[6]);
+    const uint8_t *profiles = settings + settings_len;
+    const uint32_t profiles_len = get_u16(&image[8]);
+
+    if (!settings_import(settings, settings_len)) return CONFIG_STATUS_APPLY_FAILED;
+    if (!profiles_import(profiles, profiles_len)) return CONFIG_STATUS_APPLY_FAILED;
+
+    printf("[CONFIG] Image applied (%lu bytes)\n", (unsigned long)image_len);
+    return CONFIG_STATUS_OK;
+}
+
+uint16_t config_image_expected_seq(void)
+{
+    return expected_seq;
+}
@@ -0,0 +1,68 @@
+#ifndef CONFIG_IMAGE_H
+#define CONFIG_IMAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "raw_tx.h"
+
+// Whole-board configuration as one binary image, so the host can read or
+// restore everything (keymaps, actuation, calibration, lighting, SOCD,
+// MIDI, two-stage keys, profiles) in one transfer instead of per-key
+// round trips.
+//
+// Image: [header][settings block][profiles block]
+//   header: magic u32, format u16, settings_len u16, profiles_len u16, reserved u16
+//   The blocks are the flash layouts (settings_t, profiles_flash_t), each
+//   with its own magic, version and checksum.
+//
+// Read:  CMD_GET_CONFIG_IMAGE -> RESP_CONFIG_CHUNK records
+//          [seq_lo, seq_hi, len, data(60)], then a trailer with
+//          seq 0xFFFF, len 0, data = [total u32, crc32 u32]
+// Write: BEGIN [total u32] -> CHUNK [seq u16, len, data]* -> COMMIT [crc32 u32]
+//   Chunks must arrive in order. Nothing is applied or written to flash
+//   until COMMIT has checked length, CRC32 and both blocks; then each flash
+//   sector is written once. Errors answer RESP_CONFIG_STATUS.
+
+#define CONFIG_IMAGE_MAGIC      0x49474643u  // "CFGI"
+#define CONFIG_IMAGE_FORMAT     1
+#define CONFIG_IMAGE_HEADER_LEN 12
+#define CONFIG_IMAGE_CHUNK      60
+#define CONFIG_IMAGE_TRAILER_SEQ 0xFFFF
+
+#ifndef CONFIG_IMAGE_MAX_BYTES
+#define CONFIG_IMAGE_MAX_BYTES  10240
+#endif
+
+typedef enum {
+    CONFIG_STATUS_OK = 0,
+    CONFIG_STATUS_BAD_LENGTH,
+    CONFIG_STATUS_BAD_SEQUENCE,
+    CONFIG_STATUS_BAD_CRC,
+    CONFIG_STATUS_BAD_IMAGE,     // header or block validation failed
+    CONFIG_STATUS_NOT_ACTIVE,    // chunk/commit without BEGIN
+    CONFIG_STATUS_APPLY_FAILED,
+    CONFIG_STATUS_BUSY,          // image buffer is still streaming a read
+} config_status_t;
+
+void config_image_init(void);
+
+// Serialize the live configuration and return the raw_tx job that streams it.
+// Returns false while a previous read is still streaming.
+bool config_image_read_job(raw_tx_job_t *job);
+void config_image_read_abort(void);   // the job could not be started
+
+// Write direction (called from hid_raw_receive); each returns a status
+config_status_t config_image_write_begin(uint32_t total);
+config_status_t config_image_write_chunk(uint16_t seq, const uint8_t *data, uint8_t len);
+config_status_t config_image_write_verify(uint32_t crc);
+
+// Apply a verified image and write it to flash (main loop)
+config_status_t config_image_commit(void);
+
+// Next expected chunk sequence number (for status reports)
+uint16_t config_image_expected_seq(void);
+
+uint32_t config_image_crc32(const uint8_t *data, size_t len);
+
+#endif // CONFIG_IMAGE_H
@@ -0,0 +1,208 @@
+#include "consumer_report.h"
+#include "hallscan_config.h"
+#include "usb_descriptors.h"
+#include "keyboard_report.h"
+#include "hid_queue.h"
+#include "pico/time.h"
+#include <string.h>
+
+typedef enum {
+    TAP_IDLE = 0,
+    TAP_PRESSED,   // tap usage is in the report until release_at
+    TAP_GAP,       // released; wait one frame before the next tap
+} tap_state_t;
+
+#define SYSTEM_USAGE_COUNT (SYSTEM_USAGE_WAKE_UP - SYSTEM_USAGE_POWER_DOWN + 1)
+
+// Held consumer usages in press order; a tap takes the next free slot
+static uint16_t held_usage[CONSUMER_REPORT_USAGES];
+static uint8_t held_refs[CONSUMER_REPORT_USAGES];
+static uint8_t held_count = 0;
+
+static uint8_t system_refs[SYSTEM_USAGE_COUNT];
+
+static uint16_t tap_queue[CONSUMER_TAP_QUEUE_DEPTH];
+static uint8_t tap_head = 0;
+static uint8_t tap_count = 0;
+static uint8_t tap_state = TAP_IDLE;
+static uint16_t tap_usage = 0;
+static uint32_t tap_deadline_us = 0;
+
+// Last reports handed to hid_queue
+static uint8_t sent_consumer[CONSUMER_REPORT_USAGES * 2];
+static bool tap_sent = false;   // sent_consumer includes tap_usage
+static uint8_t sent_system = 0;
+
+void consumer_report_init(void)
+{
+    held_count = 0;
+    memset(system_refs, 0, sizeof(system_refs));
+    tap_head = 0;
+    tap_count = 0;
+    tap_state = TAP_IDLE;
+    tap_usage = 0;
+    memset(sent_consumer, 0, sizeof(sent_consumer));
+    tap_sent = false;
+    sent_system = 0;
+}
+
+void consumer_report_press(uint16_t usage)
+{
+    if (usage == 0) return;
+    for (uint8_t i = 0; i < held_count; i++) {
+        if (held_usage[i] == usage) {
+            held_refs[i]++;
+            return;
+        }
+    }
+    // Array full: like a 6KRO keyboard, further usages wait for a free slot
+    if (held_count >= CONSUMER_REPORT_USAGES) return;
+    held_usage[held_count] = usage;
+    held_refs[held_count] = 1;
+    held_count++;
+}
+
+void consumer_report_release(uint16_t usage)
+{
+    for (uint8_t i = 0; i < held_count; i++) {
+        if (held_usage[i] != usage) continue;
+        if (--held_refs[i] > 0) return;
+        // Keep press order so the report does not reshuffle
+        held_count--;
+        for (uint8_t j = i; j < held_count; j++) {
+            held_usage[j] = held_usage[j + 1];
+            held_refs[j] = held_refs[j + 1];
+        }
+        return;
+    }
+}
+
+void consumer_report_system_press(uint8_t usage)
+{
+    if (usage < SYSTEM_USAGE_POWER_DOWN || usage > SYSTEM_USAGE_WAKE_UP) return;
+    system_refs[usage - SYSTEM_USAGE_POWER_DOWN]++;
+}
+
+void consumer_report_system_release(uint8_t usage)
+{
+    if (usage < SYSTEM_USAGE_POWER_DOWN || usage > SYSTEM_USAGE_WAKE_UP) return;
+    uint8_t *refs = &system_refs[usage - SYSTEM_USAGE_POWER_DOWN];
+    if (*refs > 0) (*refs)--;
+}
+
+bool consumer_report_tap(uint16_t usage)
+{
+    if (usage == 0 || tap_count >= CONSUMER_TAP_QUEUE_DEPTH) return false;
+    tap_queue[(tap_head + tap_count) % CONSUMER_TAP_QUEUE_DEPTH] = usage;
+    tap_count++;
+    return true;
+}
+
+void consumer_report_clear(void)
+{
+    held_count = 0;
+    memset(system_refs, 0, sizeof(system_refs));
+    tap_count = 0;
+    tap_state = TAP_IDLE;
+    tap_usage = 0;
+}
+
+// Encode the consumer report: held usages, then an active tap if a slot is left
+static bool encode_consumer(uint8_t out[CONSUMER_REPORT_USAGES * 2])
+{
+    memset(out, 0, CONSUMER_REPORT_USAGES * 2);
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < held_count; i++, n++) {
+        out[n * 2] = (uint8_t)(held_usage[i] & 0xFF);
+        out[n * 2 + 1] = (uint8_t)(held_usage[i] >> 8);
+    }
+    if (tap_state != TAP_PRESSED) return false;
+    // A tap of a held usage is already in the report; listing it twice
+    // would make the host lose its release
+    for (uint8_t i = 0; i < held_count; i++) {
+        if (held_usage[i] == tap_usage) return true;
+    }
+    if (n >= CONSUMER_REPORT_USAGES) return false;
+    out[n * 2] = (uint8_t)(tap_usage & 0xFF);
+    out[n * 2 + 1] = (uint8_t)(tap_usage >> 8);
+    return true;
+}
+
+static uint8_t encode_system(void)
+{
+    for (uint8_t i = 0; i < SYSTEM_USAGE_COUNT; i++) {
+        if (system_refs[i]) return (uint8_t)(SYSTEM_USAGE_POWER_DOWN + i);
+    }
+    return 0;
+}
+
+static bool send_if_changed(void)
+{
+    // Neither report exists in boot protocol
+    if (keyboard_report_boot_protocol()) return false;
+
+    bool ok = true;
+    uint8_t report[CONSUMER_REPORT_USAGES * 2];
+    const bool with_tap = encode_consumer(report);
+    if (memcmp(report, sent_consumer, sizeof(report)) != 0) {
+        if (hid_queue_send(ITF_NUM_HID_KBD, REPORT_ID_KBD_CONSUMER, report, sizeof(report), HID_QUEUE_FLAG_STATE)) {
+            memcpy(sent_consumer, report, sizeof(report));
+            tap_sent = with_tap;
+        } else {
+            ok = false;
+        }
+    } else {
+        tap_sent = with_tap;
+    }
+
+    const uint8_t system = encode_system();
+    if (system != sent_system) {
+        if (hid_queue_send(ITF_NUM_HID_KBD, REPORT_ID_KBD_SYSTEM, &system, sizeof(system), HID_QUEUE_FLAG_STATE)) {
+            sent_system = system;
+        } else {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+void consumer_report_task(void)
+{
+    const uint32_t now = time_us_32();
+
+    switch (tap_state) {
+        case TAP_IDLE:
+            if (tap_count == 0 || keyboard_report_boot_protocol()) break;
+            // All slots held: the tap waits rather than be dropped
+            if (held_count >= CONSUMER_REPORT_USAGES) break;
+            tap_usage = tap_queue[tap_head];
+            tap_head = (uint8_t)((tap_head + 1) % CONSUMER_TAP_QUEUE_DEPTH);
+            tap_count--;
+            tap_state = TAP_PRESSED;
+            send_if_changed();
+            if (!tap_sent) {
+                // Queue full: the press goes out on a later pass, start timing then
+                tap_deadline_us = now;
+                return;
+            }
+            tap_deadline_us = now + CONSUMER_TAP_HOLD_MS * 1000u;
+            return;
+
+        case TAP_PRESSED:
+            if (!tap_sent) {
+                send_if_changed();
+                if (tap_sent) tap_deadline_us = now + CONSUMER_TAP_HOLD_MS * 1000u;
+                return;
+            }
+            if ((int32_t)(now - tap_deadline_us) < 0) break;
+            tap_state = TAP_GAP;
+            tap_deadline_us = now + 1000u;  // next tap one USB frame after the release
+            break;
+
+        case TAP_GAP:
+            if ((int32_t)(now - tap_deadline_us) >= 0) tap_state = TAP_IDLE;
+            break;
+    }
+
+    send_if_changed();
+}
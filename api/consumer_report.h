@@ -0,0 +1,45 @@
+#ifndef CONSUMER_REPORT_H
+#define CONSUMER_REPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Consumer control (media keys) and system control (power, sleep, wake) on
+// the keyboard interface. Held keys and timed taps (encoder detents, encoder
+// switch) share one consumer report; taps are scheduled instead of sleeping,
+// so they never stall the scan loop.
+//
+// Consumer report: CONSUMER_REPORT_USAGES 16-bit usages (0 = empty slot),
+// so several media keys can be held at once. System report: one usage
+// (0x81 power down, 0x82 sleep, 0x83 wake up, 0 = none).
+
+#ifndef CONSUMER_TAP_QUEUE_DEPTH
+#define CONSUMER_TAP_QUEUE_DEPTH 16
+#endif
+
+#define CONSUMER_REPORT_USAGES 4   // simultaneous consumer usages (report array size)
+
+// Generic Desktop system control usages
+#define SYSTEM_USAGE_POWER_DOWN 0x81
+#define SYSTEM_USAGE_SLEEP      0x82
+#define SYSTEM_USAGE_WAKE_UP    0x83
+
+void consumer_report_init(void);
+
+// Held usages from key events. Usages are reference counted, so two keys
+// bound to the same usage release correctly.
+void consumer_report_press(uint16_t usage);
+void consumer_report_release(uint16_t usage);
+void consumer_report_system_press(uint8_t usage);
+void consumer_report_system_release(uint8_t usage);
+
+// Queue a press + timed release. Returns false if the tap queue is full.
+bool consumer_report_tap(uint16_t usage);
+
+// Release everything (held and queued taps)
+void consumer_report_clear(void);
+
+// Advance tap timing and send the reports that changed. Call every loop.
+void consumer_report_task(void);
+
+#endif // CONSUMER_REPORT_H
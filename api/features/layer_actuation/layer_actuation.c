@@ -0,0 +1,120 @@
+// Per-layer actuation profiles implementation
+//
+// Flash keeps only percent values (one byte per key per layer); the ADC
+// thresholds used by the scan loop are rebuilt from them at load time.
+
+#include "layer_actuation.h"
+#include <string.h>
+
+#define LAYER_TABLES (MAX_LAYERS - 1)  // layer 0 always uses the base table
+
+static uint8_t layer_mask = 0;  // bit N = layer N has its own table
+static uint8_t layer_act_pct[LAYER_TABLES][SENSOR_COUNT];
+static uint8_t layer_hyst_pct[LAYER_TABLES][SENSOR_COUNT];
+
+static layer_actuation_table_t base_table;
+static layer_actuation_table_t layer_tables[LAYER_TABLES];
+static const layer_actuation_table_t *active_tables[MAX_LAYERS];
+
+static uint16_t release_from(uint16_t press, uint16_t baseline, uint8_t hysteresis) {
+    uint32_t rel = (uint32_t)press + ((uint32_t)baseline * (uint32_t)hysteresis) / 100;
+    return (rel > 0xFFFF) ? 0xFFFF : (uint16_t)rel;
+}
+
+static void rebuild_base(void) {
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        base_table.press[i] = sensor_thresholds[i];
+        base_table.release[i] = release_from(sensor_thresholds[i], sensor_baseline[i], HALLSCAN_HYSTERESIS_PERCENT);
+    }
+}
+
+static void rebuild_layer(uint8_t t) {
+    layer_actuation_table_t *tbl = &layer_tables[t];
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        const uint8_t act = layer_act_pct[t][i];
+        const uint16_t baseline = sensor_baseline[i];
+        if (act == 0 || act >= 100 || baseline == 0) {
+            tbl->press[i] = base_table.press[i];
+            tbl->release[i] = base_table.release[i];
+            continue;
+        }
+        uint32_t thr = ((uint32_t)baseline * (100 - (uint32_t)act)) / 100;
+        tbl->press[i] = (thr > 0xFFFF) ? 0xFFFF : (uint16_t)thr;
+        tbl->release[i] = release_from(tbl->press[i], baseline, layer_hyst_pct[t][i]);
+    }
+}
+
+static void update_pointers(void) {
+    active_tables[0] = &base_table;
+    for (uint8_t layer = 1; layer < MAX_LAYERS; layer++) {
+        active_tables[layer] = (layer_mask & (1u << layer)) ? &layer_tables[layer - 1] : &base_table;
+    }
+}
+
+void layer_actuation_init(void) {
+    layer_mask = 0;
+    memset(layer_act_pct, 0, sizeof(layer_act_pct));
+    memset(layer_hyst_pct, 0, sizeof(layer_hyst_pct));
+    layer_actuation_recompute();
+}
+
+void layer_actuation_recompute(void) {
+    rebuild_base();
+    for (uint8_t t = 0; t < LAYER_TABLES; t++) {
+        rebuild_layer(t);
+    }
+    update_pointers();
+}
+
+const layer_actuation_table_t *layer_actuation_select(uint8_t layer) {
+    if (layer >= MAX_LAYERS) layer = 0;
+    return active_tables[layer];
+}
+
+bool layer_actuation_set_enabled(uint8_t layer, bool enabled) {
+    if (layer == 0 || layer >= MAX_LAYERS) return false;
+    if (enabled) layer_mask |= (uint8_t)(1u << layer);
+    else layer_mask &= (uint8_t)~(1u << layer);
+    update_pointers();
+    return true;
+}
+
+bool layer_actuation_get_enabled(uint8_t layer) {
+    if (layer == 0 || layer >= MAX_LAYERS) return false;
+    return (layer_mask & (1u << layer)) != 0;
+}
+
+bool layer_actuation_set_key(uint8_t layer, uint8_t key_idx, uint8_t actuation, uint8_t hysteresis) {
+    if (layer == 0 || layer >= MAX_LAYERS || key_idx >= SENSOR_COUNT) return false;
+    const uint8_t t = layer - 1;
+    layer_act_pct[t][key_idx] = actuation;
+    layer_hyst_pct[t][key_idx] = hysteresis;
+    rebuild_layer(t);
+    return true;
+}
+
+bool layer_actuation_get_key(uint8_t layer, uint8_t key_idx, uint8_t *actuation, uint8_t *hysteresis) {
+    if (layer == 0 || layer >= MAX_LAYERS || key_idx >= SENSOR_COUNT) return false;
+    if (actuation) *actuation = layer_act_pct[layer - 1][key_idx];
+    if (hysteresis) *hysteresis = layer_hyst_pct[layer - 1][key_idx];
+    return true;
+}
+
+uint8_t layer_actuation_get_config(uint8_t actuation[], uint8_t hysteresis[], uint16_t count) {
+    if (count > SENSOR_COUNT) count = SENSOR_COUNT;
+    for (uint8_t t = 0; t < LAYER_TABLES; t++) {
+        memcpy(&actuation[t * count], layer_act_pct[t], count);
+        memcpy(&hysteresis[t * count], layer_hyst_pct[t], count);
+    }
+    return layer_mask;
+}
+
+void layer_actuation_set_config(uint8_t mask, const uint8_t actuation[], const uint8_t hysteresis[], uint16_t count) {
+    if (count > SENSOR_COUNT) count = SENSOR_COUNT;
+    layer_mask = mask & (uint8_t)(((1u << MAX_LAYERS) - 1) & ~1u);
+    for (uint8_t t = 0; t < LAYER_TABLES; t++) {
+        memcpy(layer_act_pct[t], &actuation[t * count], count);
+        memcpy(layer_hyst_pct[t], &hysteresis[t * count], count);
+    }
+    layer_actuation_recompute();
+}
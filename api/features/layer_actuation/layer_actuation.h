@@ -0,0 +1,47 @@
+// Per-layer actuation profiles
+// Optional actuation/hysteresis tables for layers 1+, e.g. a gaming layer
+// with a shallow actuation point and a typing layer with a deep one. The
+// active table is selected by pointer when the layer changes; layers
+// without their own table use the base table (sensor_thresholds).
+
+#ifndef LAYER_ACTUATION_H
+#define LAYER_ACTUATION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hallscan_config.h"
+
+#ifndef MAX_LAYERS
+#define MAX_LAYERS 4
+#endif
+
+// Precomputed ADC thresholds for one layer
+typedef struct {
+    uint16_t press[SENSOR_COUNT];    // Press when ADC drops below this (0 = key not calibrated)
+    uint16_t release[SENSOR_COUNT];  // Release when ADC rises above this
+} layer_actuation_table_t;
+
+// Initialize module (no per-layer tables)
+void layer_actuation_init(void);
+
+// Rebuild the base table from sensor_thresholds and the per-layer tables
+// from sensor_baseline. Call after calibration, settings load or a change
+// to sensor_thresholds.
+void layer_actuation_recompute(void);
+
+// Table to scan with for a layer - O(1) pointer lookup
+const layer_actuation_table_t *layer_actuation_select(uint8_t layer);
+
+// Per-layer configuration (layer 1..MAX_LAYERS-1, percent of baseline).
+// A key with actuation 0 uses the base threshold on that layer.
+bool layer_actuation_set_enabled(uint8_t layer, bool enabled);
+bool layer_actuation_get_enabled(uint8_t layer);
+bool layer_actuation_set_key(uint8_t layer, uint8_t key_idx, uint8_t actuation, uint8_t hysteresis);
+bool layer_actuation_get_key(uint8_t layer, uint8_t key_idx, uint8_t *actuation, uint8_t *hysteresis);
+
+// Persistence support - enable mask (bit per layer) and
+// [MAX_LAYERS - 1][count] percent tables for layers 1+
+uint8_t layer_actuation_get_config(uint8_t actuation[], uint8_t hysteresis[], uint16_t count);
+void layer_actuation_set_config(uint8_t mask, const uint8_t actuation[], const uint8_t hysteresis[], uint16_t count);
+
+#endif // LAYER_ACTUATION_H
@@ -0,0 +1,244 @@
+// MIDI implementation - velocity from travel slope, aftertouch from depth
+//
+// Velocity is measured between two depth levels: the top dead zone
+// (MIDI_DEADZONE_X10) and the key's actuation point. Both crossing times are
+// interpolated between consecutive scan samples, so timing resolution is
+// better than the scan period.
+
+#include "midi.h"
+#include "hallscan_config.h"
+#include <stdio.h>
+#include <string.h>
+
+#if MIDI_ENABLE
+
+#include "tusb.h"
+
+typedef enum {
+    MIDI_KEY_IDLE = 0,   // above the dead zone
+    MIDI_KEY_TRAVEL,     // moving between dead zone and actuation
+    MIDI_KEY_ON,         // note is sounding
+} midi_key_state_t;
+
+typedef struct {
+    uint8_t state;
+    uint8_t last_depth;    // previous sample depth (0.1mm)
+    uint8_t start_depth;   // depth where the current stroke started
+    uint8_t pressure;      // last aftertouch value sent
+    uint8_t note;          // note that is sounding (valid in MIDI_KEY_ON)
+    uint32_t last_us;      // previous sample time
+    uint32_t start_us;     // time the current stroke started
+} midi_key_t;
+
+static bool midi_enabled = false;
+static bool midi_aftertouch = false;
+static uint8_t midi_channel = 0;
+static uint8_t midi_notes[SENSOR_COUNT];
+static midi_key_t midi_keys[SENSOR_COUNT];
+
+// Returns true if the message was handed to the USB stack
+static bool midi_send(uint8_t status, uint8_t data1, uint8_t data2) {
+    if (!tud_midi_mounted()) return false;
+    uint8_t msg[3] = { (uint8_t)(status | (midi_channel & 0x0F)), data1 & 0x7F, data2 & 0x7F };
+    return tud_midi_stream_write(0, msg, sizeof(msg)) == sizeof(msg);
+}
+
+// Estimate when the key crossed `level` between the previous and current sample
+static uint32_t crossing_time(const midi_key_t *k, uint8_t level, uint8_t depth, uint32_t now_us) {
+    if (depth <= k->last_depth || level <= k->last_depth) return now_us;
+    uint32_t dt = now_us - k->last_us;
+    uint32_t part = (uint32_t)(level - k->last_depth);
+    uint32_t span = (uint32_t)(depth - k->last_depth);
+    return k->last_us + (dt * part) / span;
+}
+
+// Velocity is proportional to travel speed: covering the full dead-zone to
+// actuation span in MIDI_VELOCITY_FAST_US maps to 127.
+static uint8_t compute_velocity(uint32_t dt_us, uint8_t distance, uint8_t full_span) {
+    if (dt_us == 0 || full_span == 0) return 127;
+    uint32_t v = (127u * (uint32_t)MIDI_VELOCITY_FAST_US * (uint32_t)distance) / (dt_us * (uint32_t)full_span);
+    if (v < 1) v = 1;
+    if (v > 127) v = 127;
+    return (uint8_t)v;
+}
+
+static void midi_key_off(midi_key_t *k) {
+    if (k->state == MIDI_KEY_ON) {
+        midi_send(0x80, k->note, 64);
+    }
+    k->state = MIDI_KEY_IDLE;
+    k->pressure = 0;
+}
+
+static void midi_all_keys_off(void) {
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        midi_key_off(&midi_keys[i]);
+    }
+}
+
+void midi_init(void) {
+    midi_enabled = false;
+    midi_aftertouch = false;
+    midi_channel = 0;
+    memset(midi_keys, 0, sizeof(midi_keys));
+
+    // Default map: chromatic from MIDI_BASE_NOTE in sensor order
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        int note = MIDI_BASE_NOTE + i;
+        midi_notes[i] = (note <= 127) ? (uint8_t)note : MIDI_NOTE_NONE;
+    }
+}
+
+void midi_task(void) {
+    // Host -> device MIDI is not used; drain it so the OUT endpoint never stalls.
+    uint8_t packet[4];
+    while (tud_midi_available()) {
+        tud_midi_packet_read(packet);
+    }
+}
+
+void midi_process_key(uint8_t key_idx, uint8_t depth_x10, uint8_t act_depth_x10, uint32_t now_us) {
+    if (!midi_enabled || key_idx >= SENSOR_COUNT) return;
+
+    midi_key_t *k = &midi_keys[key_idx];
+    const uint8_t note = midi_notes[key_idx];
+    const uint8_t dz = MIDI_DEADZONE_X10;
+    if (act_depth_x10 <= dz) act_depth_x10 = dz + 1;
+
+    if (note == MIDI_NOTE_NONE) {
+        midi_key_off(k);
+    } else {
+        switch (k->state) {
+            case MIDI_KEY_IDLE:
+                if (depth_x10 <= dz) break;
+                k->start_us = crossing_time(k, dz, depth_x10, now_us);
+                k->start_depth = dz;
+                k->state = MIDI_KEY_TRAVEL;
+                // fall through — a fast stroke can cross both levels in one scan
+
+            case MIDI_KEY_TRAVEL:
+                if (depth_x10 <= dz) {
+                    k->state = MIDI_KEY_IDLE;
+                    break;
+                }
+                if (depth_x10 >= act_depth_x10) {
+                    uint32_t t_on = crossing_time(k, act_depth_x10, depth_x10, now_us);
+                    uint8_t distance = (act_depth_x10 > k->start_depth) ? (uint8_t)(act_depth_x10 - k->start_depth) : 1;
+                    uint8_t velocity = compute_velocity(t_on - k->start_us, distance, (uint8_t)(act_depth_x10 - dz));
+                    // The key only sounds once the host has the note-on;
+                    // otherwise stay in travel and retry on the next scan
+                    if (midi_send(0x90, note, velocity)) {
+                        k->note = note;
+                        k->pressure = 0;
+                        k->state = MIDI_KEY_ON;
+                    }
+                }
+                break;
+
+            case MIDI_KEY_ON:
+                if ((uint16_t)depth_x10 + MIDI_RELEASE_HYSTERESIS_X10 < act_depth_x10) {
+                    midi_key_off(k);
+                    if (depth_x10 > dz) {
+                        // Re-strike from mid travel: time the new stroke from here
+                        k->state = MIDI_KEY_TRAVEL;
+                        k->start_us = now_us;
+                        k->start_depth = depth_x10;
+                    }
+                } else if (midi_aftertouch) {
+                    // Pressure follows depth past the actuation point
+                    uint8_t span = (uint8_t)(40 - act_depth_x10);
+                    uint8_t past = (depth_x10 > act_depth_x10) ? (uint8_t)(depth_x10 - act_depth_x10) : 0;
+                    uint8_t pressure = span ? (uint8_t)(((uint16_t)past * 127u) / span) : 127;
+                    if (pressure > 127) pressure = 127;
+                    if (pressure != k->pressure) {
+                        k->pressure = pressure;
+                        midi_send(0xA0, k->note, pressure);
+                    }
+                }
+                break;
+        }
+    }
+
+    k->last_depth = depth_x10;
+    k->last_us = now_us;
+}
+
+bool midi_key_claimed(uint8_t key_idx) {
+    if (!midi_enabled || key_idx >= SENSOR_COUNT) return false;
+    return midi_notes[key_idx] != MIDI_NOTE_NONE;
+}
+
+void midi_set_enabled(bool enabled) {
+    if (enabled == midi_enabled) return;
+    if (!enabled) midi_all_keys_off();
+    midi_enabled = enabled;
+    printf("[MIDI] %s\n", enabled ? "enabled" : "disabled");
+}
+
+bool midi_get_enabled(void) {
+    return midi_enabled;
+}
+
+void midi_set_channel(uint8_t channel) {
+    if (channel > 15) return;
+    if (channel != midi_channel) midi_all_keys_off();
+    midi_channel = channel;
+}
+
+uint8_t midi_get_channel(void) {
+    return midi_channel;
+}
+
+void midi_set_aftertouch(bool enabled) {
+    midi_aftertouch = enabled;
+}
+
+bool midi_get_aftertouch(void) {
+    return midi_aftertouch;
+}
+
+bool midi_set_note(uint8_t key_idx, uint8_t note) {
+    if (key_idx >= SENSOR_COUNT) return false;
+    if (note > 127) note = MIDI_NOTE_NONE;
+    if (midi_notes[key_idx] != note) midi_key_off(&midi_keys[key_idx]);
+    midi_notes[key_idx] = note;
+    return true;
+}
+
+uint8_t midi_get_note(uint8_t key_idx) {
+    if (key_idx >= SENSOR_COUNT) return MIDI_NOTE_NONE;
+    return midi_notes[key_idx];
+}
+
+void midi_get_all_notes(uint8_t notes[], uint16_t count) {
+    if (count > SENSOR_COUNT) count = SENSOR_COUNT;
+    memcpy(notes, midi_notes, count);
+}
+
+void midi_set_all_notes(const uint8_t notes[], uint16_t count) {
+    if (count > SENSOR_COUNT) count = SENSOR_COUNT;
+    for (uint16_t i = 0; i < count; i++) {
+        midi_set_note((uint8_t)i, notes[i]);
+    }
+}
+
+#else // !MIDI_ENABLE — stubs
+
+void midi_init(void) {}
+void midi_task(void) {}
+void midi_process_key(uint8_t key_idx, uint8_t depth_x10, uint8_t act_depth_x10, uint32_t now_us) {
+    (void)key_idx; (void)depth_x10; (void)act_depth_x10; (void)now_us;
+}
+bool midi_key_claimed(uint8_t key_idx) { (void)key_idx; return false; }
+void midi_set_enabled(bool enabled) { (void)enabled; }
+bool midi_get_enabled(void) { return false; }
+void midi_set_channel(uint8_t channel) { (void)channel; }
+uint8_t midi_get_channel(void) { return 0; }
+void midi_set_aftertouch(bool enabled) { (void)enabled; }
+bool midi_get_aftertouch(void) { return false; }
+bool midi_set_note(uint8_t key_idx, uint8_t note) { (void)key_idx; (void)note; return false; }
+uint8_t midi_get_note(uint8_t key_idx) { (void)key_idx; return MIDI_NOTE_NONE; }
+void midi_get_all_notes(uint8_t notes[], uint16_t count) { memset(notes, MIDI_NOTE_NONE, count); }
+void midi_set_all_notes(const uint8_t notes[], uint16_t count) { (void)notes; (void)count; }
+
+#endif // MIDI_ENABLE
@@ -0,0 +1,43 @@
+// Velocity-sensitive USB MIDI output
+// Turns analog key travel into note-on/off with velocity and optional
+// polyphonic aftertouch. Enabled at build time with MIDI_ENABLE.
+
+#ifndef MIDI_H
+#define MIDI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Note map value for "this key is not a MIDI key"
+#define MIDI_NOTE_NONE 0xFF
+
+// Initialize MIDI module (default note map, all keys idle)
+void midi_init(void);
+
+// Service the MIDI endpoint (drain host -> device packets)
+void midi_task(void);
+
+// Feed one sample for a key from the scan loop.
+// depth_x10 / act_depth_x10 are in 0.1mm (0..40), now_us is the sample time.
+void midi_process_key(uint8_t key_idx, uint8_t depth_x10, uint8_t act_depth_x10, uint32_t now_us);
+
+// True if this key is routed to MIDI and must be left out of keyboard reports
+bool midi_key_claimed(uint8_t key_idx);
+
+// Output mode
+void midi_set_enabled(bool enabled);
+bool midi_get_enabled(void);
+void midi_set_channel(uint8_t channel);   // 0..15
+uint8_t midi_get_channel(void);
+void midi_set_aftertouch(bool enabled);
+bool midi_get_aftertouch(void);
+
+// Per-key note map
+bool midi_set_note(uint8_t key_idx, uint8_t note);
+uint8_t midi_get_note(uint8_t key_idx);
+
+// Persistence support - get/set the whole note map for flash storage
+void midi_get_all_notes(uint8_t notes[], uint16_t count);
+void midi_set_all_notes(const uint8_t notes[], uint16_t count);
+
+#endif // MIDI_H
@@ -0,0 +1,247 @@
+// Mouse keys implementation - speed from key depth, sub-count accumulation
+//
+// Each held move/wheel key adds its curve speed (Q8 per millisecond) to an
+// accumulator scaled by the real time since the last pass, so the cursor
+// speed does not depend on the scan rate. Whole counts leave in the report;
+// the fraction carries over.
+
+#include "mouse.h"
+#include "hallscan_config.h"
+#include "keycodes.h"
+#include <string.h>
+
+#if MOUSE_ENABLE
+
+#include "usb_descriptors.h"
+#include "keyboard_report.h"
+#include "hid_queue.h"
+#include "pico/time.h"
+
+#define MOUSE_MAX_HELD     8       // move/wheel keys held at once
+#define MOUSE_REPORT_US    1000    // one report per frame while moving
+#define MOUSE_ACC_LIMIT    (127 * 256)
+#define MOUSE_MAX_STEP_US  (4 * MOUSE_REPORT_US)   // a stalled pass moves no further
+
+typedef struct {
+    uint8_t key_idx;
+    uint8_t kc;
+    uint8_t depth_x10;
+} mouse_held_t;
+
+static const uint16_t default_curves[MOUSE_CURVE_COUNT][MOUSE_CURVE_POINTS] = {
+    { 64, 256, 768, 1536, 3072 },  // move: 0.25 .. 12 counts/ms
+    { 4, 12, 32, 64, 128 },        // wheel: ~16 .. 500 detents/s
+};
+
+static uint16_t curves[MOUSE_CURVE_COUNT][MOUSE_CURVE_POINTS];
+
+static mouse_held_t held[MOUSE_MAX_HELD];
+static uint8_t held_count = 0;
+static uint8_t held_bits[(SENSOR_COUNT + 7) / 8];
+
+static uint8_t buttons = 0;
+static uint8_t sent_buttons = 0;
+
+// Q8 accumulators: x, y, wheel, pan
+static int32_t acc[4];
+static uint32_t last_pass_us = 0;
+static uint32_t last_report_us = 0;
+
+static uint8_t button_bit(uint8_t kc)
+{
+    switch (kc) {
+        case KC_BTN1: return 0x01;
+        case KC_BTN2: return 0x02;
+        case KC_BTN3: return 0x04;
+        case KC_BTN4: return 0x08;
+        case KC_BTN5: return 0x10;
+        default: return 0;
+    }
+}
+
+static uint16_t curve_speed(const uint16_t *curve, uint8_t depth_x10)
+{
+    if (depth_x10 >= 10 * (MOUSE_CURVE_POINTS - 1)) return curve[MOUSE_CURVE_POINTS - 1];
+    const uint8_t seg = depth_x10 / 10;
+    const uint8_t frac = depth_x10 % 10;
+    const int32_t a = curve[seg];
+    const int32_t b = curve[seg + 1];
+    return (uint16_t)(a + ((b - a) * frac) / 10);
+}
+
+void mouse_init(void)
+{
+    memcpy(curves, default_curves, sizeof(curves));
+    mouse_release_all();
+}
+
+bool mouse_is_keycode(uint8_t kc)
+{
+    return (kc >= KC_MS_U && kc <= KC_WH_R) || button_bit(kc) != 0;
+}
+
+void mouse_key_event(uint8_t key_idx, uint8_t kc, bool pressed)
+{
+    if (key_idx >= SENSOR_COUNT) return;
+
+    const uint8_t bit = button_bit(kc);
+    if (bit) {
+        if (pressed) buttons |= bit;
+        else buttons &= (uint8_t)~bit;
+        return;
+    }
+
+    if (pressed) {
+        if (held_count >= MOUSE_MAX_HELD) return;
+        if (held_count == 0) last_pass_us = time_us_32();
+        held[held_count].key_idx = key_idx;
+        held[held_count].kc = kc;
+        held[held_count].depth_x10 = 0;
+        held_count++;
+        held_bits[key_idx >> 3] |= (uint8_t)(1u << (key_idx & 7));
+        return;
+    }
+
+    for (uint8_t i = 0; i < held_count; i++) {
+        if (held[i].key_idx != key_idx) continue;
+        held[i] = held[--held_count];
+        held_bits[key_idx >> 3] &= (uint8_t)~(1u << (key_idx & 7));
+        break;
+    }
+    if (held_count == 0) memset(acc, 0, sizeof(acc));
+}
+
+bool mouse_key_held(uint8_t key_idx)
+{
+    if (key_idx >= SENSOR_COUNT) return false;
+    return (held_bits[key_idx >> 3] & (1u << (key_idx & 7))) != 0;
+}
+
+void mouse_key_depth(uint8_t key_idx, uint8_t depth_x10)
+{
+    for (uint8_t i = 0; i < held_count; i++) {
+        if (held[i].key_idx == key_idx) {
+            held[i].depth_x10 = depth_x10;
+            return;
+        }
+    }
+}
+
+void mouse_release_all(void)
+{
+    held_count = 0;
+    memset(held_bits, 0, sizeof(held_bits));
+    memset(acc, 0, sizeof(acc));
+    buttons = 0;
+}
+
+// Take the whole counts out of an accumulator, clamped to the report range
+static int8_t take_counts(int32_t *a)
+{
+    int32_t n = *a / 256;   // toward zero, the fraction keeps its sign
+    if (n > 127) n = 127;
+    if (n < -127) n = -127;
+    *a -= n * 256;
+    return (int8_t)n;
+}
+
+void mouse_task(void)
+{
+    const uint32_t now = time_us_32();
+
+    if (held_count > 0) {
+        // Clamped: curves go up to 65535, so speed * elapsed_us must stay in 32 bits
+        uint32_t elapsed_us = now - last_pass_us;
+        if (elapsed_us > MOUSE_MAX_STEP_US) elapsed_us = MOUSE_MAX_STEP_US;
+        last_pass_us = now;
+        for (uint8_t i = 0; i < held_count; i++) {
+            const uint8_t kc = held[i].kc;
+            const bool wheel = kc >= KC_WH_U;
+            const uint32_t speed = curve_speed(curves[wheel ? MOUSE_CURVE_WHEEL : MOUSE_CURVE_MOVE],
+                                               held[i].depth_x10);
+            const int32_t step = (int32_t)((speed * elapsed_us) / 1000);
+            switch (kc) {
+                case KC_MS_U: acc[1] -= step; break;
+                case KC_MS_D: acc[1] += step; break;
+                case KC_MS_L: acc[0] -= step; break;
+                case KC_MS_R: acc[0] += step; break;
+                case KC_WH_U: acc[2] += step; break;
+                case KC_WH_D: acc[2] -= step; break;
+                case KC_WH_L: acc[3] -= step; break;
+                case KC_WH_R: acc[3] += step; break;
+                default: break;
+            }
+        }
+        for (uint8_t a = 0; a < 4; a++) {
+            if (acc[a] > MOUSE_ACC_LIMIT) acc[a] = MOUSE_ACC_LIMIT;
+            if (acc[a] < -MOUSE_ACC_LIMIT) acc[a] = -MOUSE_ACC_LIMIT;
+        }
+    }
+
+    // Report IDs do not exist in boot protocol
+    if (keyboard_report_boot_protocol()) return;
+
+    const bool moving = acc[0] / 256 || acc[1] / 256 || acc[2] / 256 || acc[3] / 256;
+    if (buttons == sent_buttons && !moving) return;
+
+    // Button changes are never dropped; movement waits for its frame and for
+    // keyboard reports ahead of it, and keeps accumulating meanwhile
+    if (buttons == sent_buttons) {
+        if (now - last_report_us < MOUSE_REPORT_US) return;
+        if (hid_queue_pending(ITF_NUM_HID_KBD)) return;
+    }
+
+    int32_t saved[4];
+    memcpy(saved, acc, sizeof(saved));
+    uint8_t report[5];
+    report[0] = buttons;
+    report[1] = (uint8_t)take_counts(&acc[0]);
+    report[2] = (uint8_t)take_counts(&acc[1]);
+    report[3] = (uint8_t)take_counts(&acc[2]);
+    report[4] = (uint8_t)take_counts(&acc[3]);
+    // Movement is relative, so only a buttons-only report is state
+    const bool still = !report[1] && !report[2] && !report[3] && !report[4];
+    if (!hid_queue_send(ITF_NUM_HID_KBD, REPORT_ID_KBD_MOUSE, report, sizeof(report),
+                        still ? HID_QUEUE_FLAG_STATE : HID_QUEUE_FLAG_NONE)) {
+        memcpy(acc, saved, sizeof(acc));   // retry next pass
+        return;
+    }
+    sent_buttons = buttons;
+    last_report_us = now;
+}
+
+bool mouse_active(void)
+{
+    return held_count > 0 || buttons != sent_buttons;
+}
+
+bool mouse_set_curve(uint8_t which, const uint16_t points[])
+{
+    if (which >= MOUSE_CURVE_COUNT) return false;
+    memcpy(curves[which], points, sizeof(curves[which]));
+    return true;
+}
+
+void mouse_get_curve(uint8_t which, uint16_t points[])
+{
+    if (which >= MOUSE_CURVE_COUNT) {
+        memset(points, 0, MOUSE_CURVE_POINTS * sizeof(uint16_t));
+        return;
+    }
+    memcpy(points, curves[which], sizeof(curves[which]));
+}
+
+#else // !MOUSE_ENABLE — stubs
+
+void mouse_init(void) {}
+bool mouse_is_keycode(uint8_t kc) { (void)kc; return false; }
+void mouse_key_event(uint8_t key_idx, uint8_t kc, bool pressed) { (void)key_idx; (void)kc; (void)pressed; }
+bool mouse_key_held(uint8_t key_idx) { (void)key_idx; return false; }
+void mouse_key_depth(uint8_t key_idx, uint8_t depth_x10) { (void)key_idx; (void)depth_x10; }
+void mouse_release_all(void) {}
+void mouse_task(void) {}
+bool mouse_active(void) { return false; }
+bool mouse_set_curve(uint8_t which, const uint16_t points[]) { (void)which; (void)points; return false; }
+void mouse_get_curve(uint8_t which, uint16_t points[]) { (void)which; memset(points, 0, MOUSE_CURVE_POINTS * sizeof(uint16_t)); }
+
+#endif // MOUSE_ENABLE
@@ -0,0 +1,51 @@
+// Analog mouse keys
+// Cursor and wheel keys whose speed follows how far the key is pressed.
+// Reports go out on the keyboard interface (report ID 4), at most once per
+// millisecond and only while something moves or a button changes.
+// Enabled at build time with MOUSE_ENABLE.
+
+#ifndef MOUSE_H
+#define MOUSE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Speed curve: one point per millimetre of depth (0, 1, 2, 3, 4 mm),
+// linearly interpolated. Units are 1/256 count (move) or 1/256 detent
+// (wheel) per millisecond.
+#define MOUSE_CURVE_POINTS 5
+
+typedef enum {
+    MOUSE_CURVE_MOVE = 0,
+    MOUSE_CURVE_WHEEL,
+    MOUSE_CURVE_COUNT
+} mouse_curve_t;
+
+// Initialize mouse module (default curves, nothing held)
+void mouse_init(void);
+
+// True for KC_MS_* / KC_WH_* / KC_BTN* keycodes
+bool mouse_is_keycode(uint8_t kc);
+
+// Key events (kc is the keycode captured at press time)
+void mouse_key_event(uint8_t key_idx, uint8_t kc, bool pressed);
+
+// Scan loop: feed depth (0.1mm, 0..40) for keys holding a move/wheel keycode
+bool mouse_key_held(uint8_t key_idx);
+void mouse_key_depth(uint8_t key_idx, uint8_t depth_x10);
+
+// Release every button and stop all movement
+void mouse_release_all(void);
+
+// Accumulate movement and send the report. Call every loop.
+void mouse_task(void);
+
+// True while a move/wheel key is held or a button change is unsent: the
+// scan loop must then come round at least once per report interval
+bool mouse_active(void);
+
+// Curve configuration (points[MOUSE_CURVE_POINTS])
+bool mouse_set_curve(uint8_t which, const uint16_t points[]);
+void mouse_get_curve(uint8_t which, uint16_t points[]);
+
+#endif // MOUSE_H
@@ -0,0 +1,108 @@
+// Two-stage key implementation
+
+#include "two_stage.h"
+#include "hallscan_config.h"
+#include <string.h>
+
+#ifndef MAX_LAYERS
+#define MAX_LAYERS 4
+#endif
+
+static two_stage_key_t stage_keys[SENSOR_COUNT];
+static uint8_t stage_keymap[MAX_LAYERS][SENSOR_COUNT];
+
+// Cached ADC thresholds (0 = deep stage disabled for this key)
+static uint16_t stage_press_thr[SENSOR_COUNT];
+static uint16_t stage_release_thr[SENSOR_COUNT];
+
+static void compute_threshold(uint8_t idx) {
+    const two_stage_key_t *k = &stage_keys[idx];
+    const uint32_t baseline = sensor_baseline[idx];
+
+    if (k->actuation == 0 || k->actuation >= 100 || baseline == 0) {
+        stage_press_thr[idx] = 0;
+        stage_release_thr[idx] = 0;
+        return;
+    }
+
+    uint32_t thr = (baseline * (100 - (uint32_t)k->actuation)) / 100;
+    uint32_t rel = thr + (baseline * (uint32_t)k->hysteresis) / 100;
+    if (thr > 0xFFFF) thr = 0xFFFF;
+    if (rel > 0xFFFF) rel = 0xFFFF;
+    stage_press_thr[idx] = (uint16_t)thr;
+    stage_release_thr[idx] = (uint16_t)rel;
+}
+
+void two_stage_init(void) {
+    memset(stage_keys, 0, sizeof(stage_keys));
+    memset(stage_keymap, 0, sizeof(stage_keymap));
+    memset(stage_press_thr, 0, sizeof(stage_press_thr));
+    memset(stage_release_thr, 0, sizeof(stage_release_thr));
+}
+
+void two_stage_recompute_thresholds(void) {
+    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+        compute_threshold(i);
+    }
+}
+
+bool two_stage_evaluate(uint8_t key_idx, uint16_t adc_val, bool was_deep) {
+    if (key_idx >= SENSOR_COUNT) return false;
+    const uint16_t thr = stage_press_thr[key_idx];
+    if (thr == 0) return false;
+
+    // Same direction as the primary threshold: ADC drops as the key goes down
+    if (was_deep) return adc_val <= stage_release_thr[key_idx];
+    return adc_val < thr;
+}
+
+bool two_stage_set_key(uint8_t key_idx, uint8_t actuation, uint8_t hysteresis, uint8_t mode) {
+    if (key_idx >= SENSOR_COUNT) return false;
+    if (mode > TWO_STAGE_MODE_REPLACE) mode = TWO_STAGE_MODE_ADD;
+    stage_keys[key_idx].actuation = actuation;
+    stage_keys[key_idx].hysteresis = hysteresis;
+    stage_keys[key_idx].mode = mode;
+    compute_threshold(key_idx);
+    return true;
+}
+
+bool two_stage_get_key(uint8_t key_idx, two_stage_key_t *out) {
+    if (key_idx >= SENSOR_COUNT || !out) return false;
+    *out = stage_keys[key_idx];
+    return true;
+}
+
+uint8_t two_stage_get_mode(uint8_t key_idx) {
+    if (key_idx >= SENSOR_COUNT) return TWO_STAGE_MODE_ADD;
+    return stage_keys[key_idx].mode;
+}
+
+bool two_stage_set_keycode(uint8_t layer, uint8_t key_idx, uint8_t keycode) {
+    if (layer >= MAX_LAYERS || key_idx >= SENSOR_COUNT) return false;
+    stage_keymap[layer][key_idx] = keycode;
+    return true;
+}
+
+uint8_t two_stage_get_keycode(uint8_t layer, uint8_t key_idx) {
+    if (layer >= MAX_LAYERS || key_idx >= SENSOR_COUNT) return 0;
+    uint8_t kc = stage_keymap[layer][key_idx];
+    if (kc == 0 && layer > 0) kc = stage_keymap[0][key_idx];
+    return kc;
+}
+
+void two_stage_get_config(two_stage_key_t keys[], uint8_t keycodes[], uint16_t count) {
+    if (count > SENSOR_COUNT) count = SENSOR_COUNT;
+    memcpy(keys, stage_keys, count * sizeof(two_stage_key_t));
+    for (uint8_t layer = 0; layer < MAX_LAYERS; layer++) {
+        memcpy(&keycodes[layer * count], stage_keymap[layer], count);
+    }
+}
+
+void two_stage_set_config(const two_stage_key_t keys[], const uint8_t keycodes[], uint16_t count) {
+    if (count > SENSOR_COUNT) count = SENSOR_COUNT;
+    memcpy(stage_keys, keys, count * sizeof(two_stage_key_t));
+    for (uint8_t layer = 0; layer < MAX_LAYERS; layer++) {
+        memcpy(stage_keymap[layer], &keycodes[layer * count], count);
+    }
+    two_stage_recompute_thresholds();
+}
@@ -0,0 +1,47 @@
+// Two-stage keys
+// Optional second (deep) actuation point per key with its own keycode per
+// layer and its own hysteresis, evaluated in the same scan pass as the
+// primary threshold.
+
+#ifndef TWO_STAGE_H
+#define TWO_STAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// What happens to the primary keycode while the deep stage is active
+typedef enum {
+    TWO_STAGE_MODE_ADD = 0,      // Both held: shallow = Ctrl, deep = Ctrl+Shift
+    TWO_STAGE_MODE_REPLACE = 1,  // Deep replaces primary: shallow = walk, deep = sprint
+} two_stage_mode_t;
+
+// Per-key deep stage configuration
+typedef struct {
+    uint8_t actuation;   // Percent of baseline drop (same unit as CMD_SET_ACTUATION), 0 = disabled
+    uint8_t hysteresis;  // Percent of baseline
+    uint8_t mode;        // two_stage_mode_t
+} two_stage_key_t;
+
+// Initialize module (all keys single-stage)
+void two_stage_init(void);
+
+// Recompute ADC thresholds from sensor_baseline (call after calibration)
+void two_stage_recompute_thresholds(void);
+
+// Evaluate the deep stage for one sample. Returns the new deep state.
+bool two_stage_evaluate(uint8_t key_idx, uint16_t adc_val, bool was_deep);
+
+// Per-key configuration
+bool two_stage_set_key(uint8_t key_idx, uint8_t actuation, uint8_t hysteresis, uint8_t mode);
+bool two_stage_get_key(uint8_t key_idx, two_stage_key_t *out);
+uint8_t two_stage_get_mode(uint8_t key_idx);
+
+// Deep keycodes per layer (0 on layers 1+ falls back to layer 0)
+bool two_stage_set_keycode(uint8_t layer, uint8_t key_idx, uint8_t keycode);
+uint8_t two_stage_get_keycode(uint8_t layer, uint8_t key_idx);
+
+// Persistence support - raw tables for flash storage
+void two_stage_get_config(two_stage_key_t keys[], uint8_t keycodes[], uint16_t count);
+void two_stage_set_config(const two_stage_key_t keys[], const uint8_t keycodes[], uint16_t count);
+
+#endif // TWO_STAGE_H
@@ -69,6 +69,34 @@ extern "C" {
   #define CAPS_LOCK_INDICATOR 0
 #endif
 
+#ifdef MIDI_ENABLE
+  #undef  MIDI_ENABLE
+  #define MIDI_ENABLE 1
+#else
+  #define MIDI_ENABLE 0
+#endif
+
+#ifdef NKRO_ENABLE
+  #undef  NKRO_ENABLE
+  #define NKRO_ENABLE 1
+#else
+  #define NKRO_ENABLE 0
+#endif
+
+#ifdef MOUSE_ENABLE
+  #undef  MOUSE_ENABLE
+  #define MOUSE_ENABLE 1
+#else
+  #define MOUSE_ENABLE 0
+#endif
+
+#ifdef SOF_ALIGN_ENABLE
+  #undef  SOF_ALIGN_ENABLE
+  #define SOF_ALIGN_ENABLE 1
+#else
+  #define SOF_ALIGN_ENABLE 0
+#endif
+
 // Legacy compatibility aliases for internal code
 #define RGB_ENABLED                  RGB_ENABLE
 #define CAPS_LOCK_INDICATOR_ENABLED  CAPS_LOCK_INDICATOR
@@ -179,6 +207,55 @@ extern "C" {
   #define ADC_PRINT_ENABLED 0
 #endif
 
+#ifndef CONSUMER_TAP_HOLD_MS
+  #define CONSUMER_TAP_HOLD_MS 5       // Encoder/media tap: press held this long before release
+#endif
+
+#ifndef SOF_ALIGN_MARGIN_US
+  #define SOF_ALIGN_MARGIN_US 50       // SOF alignment: queue the report this long before the frame
+#endif
+
+#ifndef LED_GAMMA_CORRECTION
+  #define LED_GAMMA_CORRECTION 1       // LED output: gamma 2.2 before the brightness cap (0 = linear)
+#endif
+
+#ifndef LIGHTING_FPS
+  #define LIGHTING_FPS 100             // LED output: core1 frame rate
+#endif
+
+#ifndef LED_REFRESH_MS
+  #define LED_REFRESH_MS 1000          // LED output: resend an unchanged frame this often
+#endif
+
+#ifndef SUSPEND_SCAN_INTERVAL_MS
+  #define SUSPEND_SCAN_INTERVAL_MS 20  // USB suspend: wake check interval
+#endif
+
+#ifndef SUSPEND_WAKE_DEPTH_X10
+  #define SUSPEND_WAKE_DEPTH_X10 5     // USB suspend: depth change (0.1mm) that wakes the host
+#endif
+
+// ============================================================================
+// MIDI DEFAULTS (only used when MIDI_ENABLE is defined)
+// ============================================================================
+// Depths are in 0.1mm units, matching the depth reported by ADC streaming.
+
+#ifndef MIDI_BASE_NOTE
+  #define MIDI_BASE_NOTE 36            // Note of sensor 0 in the default map (C2)
+#endif
+
+#ifndef MIDI_DEADZONE_X10
+  #define MIDI_DEADZONE_X10 2          // Top dead zone; velocity timing starts here
+#endif
+
+#ifndef MIDI_VELOCITY_FAST_US
+  #define MIDI_VELOCITY_FAST_US 3000   // Dead zone -> actuation in this time = velocity 127
+#endif
+
+#ifndef MIDI_RELEASE_HYSTERESIS_X10
+  #define MIDI_RELEASE_HYSTERESIS_X10 2
+#endif
+
 // ============================================================================
 // DERIVED SENSOR TYPES
 // ============================================================================
@@ -0,0 +1,57 @@
+#include "hid_cmd.h"
+#include "hardware/sync.h"
+#include <string.h>
+
+#if (HID_CMD_QUEUE_DEPTH & (HID_CMD_QUEUE_DEPTH - 1)) != 0
+#error "HID_CMD_QUEUE_DEPTH must be a power of two"
+#endif
+
+// Single producer / single consumer: only hid_raw_receive writes head and
+// only the main loop writes tail. Indices run free and wrap naturally;
+// head - tail is the fill level.
+static hid_cmd_t ring[HID_CMD_QUEUE_DEPTH];
+static volatile uint32_t head = 0;
+static volatile uint32_t tail = 0;
+static hid_cmd_stats_t stats;
+
+void hid_cmd_init(void)
+{
+    head = 0;
+    tail = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool hid_cmd_push(const hid_cmd_t *cmd)
+{
+    uint32_t h = head;
+    uint32_t used = h - tail;
+    if (used >= HID_CMD_QUEUE_DEPTH) {
+        stats.dropped++;
+        return false;
+    }
+    ring[h & (HID_CMD_QUEUE_DEPTH - 1)] = *cmd;
+    // Record must be complete before the consumer can see it
+    __dmb();
+    head = h + 1;
+
+    stats.pushed++;
+    if (used + 1 > stats.high_water) stats.high_water = (uint8_t)(used + 1);
+    return true;
+}
+
+bool hid_cmd_pop(hid_cmd_t *out)
+{
+    uint32_t t = tail;
+    if (t == head) return false;
+    __dmb();
+    *out = ring[t & (HID_CMD_QUEUE_DEPTH - 1)];
+    // Slot must be read before the producer may reuse it
+    __dmb();
+    tail = t + 1;
+    return true;
+}
+
+void hid_cmd_get_stats(hid_cmd_stats_t *out)
+{
+    if (out) *out = stats;
+}
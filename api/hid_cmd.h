@@ -0,0 +1,70 @@
+#ifndef HID_CMD_H
+#define HID_CMD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Raw HID commands that must run in main loop context are queued here by
+// hid_raw_receive (producer) and drained by the main loop (consumer).
+// Every accepted report becomes one record, so back-to-back writes are
+// applied in order instead of overwriting each other.
+
+#ifndef HID_CMD_QUEUE_DEPTH
+#define HID_CMD_QUEUE_DEPTH 32     // must be a power of two
+#endif
+
+typedef enum {
+    HID_CMD_LED_POWER_TOGGLE = 0,
+    HID_CMD_LED_POWER_SET,         // u8 = 0/1
+    HID_CMD_SOCD_TOGGLE,
+    HID_CMD_SOCD_SET,              // u8 = 0/1
+    HID_CMD_BRIGHTNESS_SET,        // u8 = 0-100
+    HID_CMD_ACTUATION_SET,         // actuation
+    HID_CMD_LAYER_SET,             // u8 = layer
+    HID_CMD_KEYMAP_SET,            // keymap
+    HID_CMD_CALIBRATE,
+    HID_CMD_BOOTLOADER,
+    HID_CMD_SAVE_SETTINGS,         // legacy save profile (whole settings block)
+    HID_CMD_LOAD_SETTINGS,         // legacy load profile
+    HID_CMD_PROFILE_SAVE,          // u8 = slot
+    HID_CMD_PROFILE_LOAD,          // u8 = slot
+    HID_CMD_PROFILE_DELETE,        // u8 = slot
+    HID_CMD_PROFILE_BLANK,         // u8 = slot
+    HID_CMD_ADC_STREAM_ENABLE,     // u8 = 0/1
+    HID_CMD_GET_KEY_ADC,           // u8 = key index
+    HID_CMD_ADV_CAL_ENABLE,        // u8 = 0/1
+    HID_CMD_ADV_CAL_SET_KEY,       // adv_cal
+    HID_CMD_ADV_CAL_GET_KEY,       // u8 = key index
+    HID_CMD_CONFIG_COMMIT,         // apply the verified configuration image
+    HID_CMD_TYPE_COUNT
+} hid_cmd_type_t;
+
+typedef struct {
+    uint8_t type;       // hid_cmd_type_t
+    uint8_t instance;   // RAW interface the request arrived on
+    union {
+        uint8_t u8;
+        struct { uint8_t key_idx; uint8_t percent; } actuation;
+        struct { uint8_t layer; uint8_t key_idx; uint8_t keycode; } keymap;
+        struct { uint8_t key_idx; uint16_t release_adc; uint16_t press_adc; } adv_cal;
+    };
+} hid_cmd_t;
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t dropped;    // refused because the ring was full
+    uint8_t  high_water; // deepest the ring has been
+} hid_cmd_stats_t;
+
+void hid_cmd_init(void);
+
+// Producer side (USB callback). Returns false if the ring is full; the
+// caller reports the overflow to the host.
+bool hid_cmd_push(const hid_cmd_t *cmd);
+
+// Consumer side (main loop). Returns false when the ring is empty.
+bool hid_cmd_pop(hid_cmd_t *out);
+
+void hid_cmd_get_stats(hid_cmd_stats_t *out);
+
+#endif // HID_CMD_H
@@ -0,0 +1,207 @@
+#include "hid_queue.h"
+#include "tusb.h"
+#include "pico/time.h"
+#include <string.h>
+
+// Everything here runs in tud_task() / main loop context (TinyUSB invokes
+// tud_hid_report_complete_cb from tud_task), so no locking is needed.
+
+typedef struct {
+    uint8_t report_id;
+    uint8_t flags;
+    uint8_t len;
+    uint32_t seq;       // newest hid_queue_send() this entry carries
+    uint8_t data[HID_QUEUE_MAX_REPORT];
+} hid_queue_entry_t;
+
+typedef struct {
+    hid_queue_entry_t entries[HID_QUEUE_DEPTH];
+    uint8_t head;   // next entry to send
+    uint8_t count;
+    // Last bitmap report handed to TinyUSB (coalescing reference)
+    hid_queue_entry_t last_bitmap;
+    bool last_bitmap_valid;
+    uint32_t next_seq;      // sequence of the last hid_queue_send()
+    uint32_t inflight_seq;  // sequence of the report on the endpoint
+    hid_queue_stats_t stats;
+} hid_queue_t;
+
+static hid_queue_t queues[HID_QUEUE_INSTANCES];
+static hid_queue_idle_cb_t idle_handlers[HID_QUEUE_INSTANCES][HID_QUEUE_IDLE_HANDLERS];
+static hid_queue_complete_cb_t complete_handlers[HID_QUEUE_INSTANCES];
+
+static inline hid_queue_entry_t *entry_at(hid_queue_t *q, uint8_t pos)
+{
+    return &q->entries[(q->head + pos) % HID_QUEUE_DEPTH];
+}
+
+static bool transmit(uint8_t instance, const hid_queue_entry_t *e)
+{
+    if (!tud_hid_n_ready(instance)) return false;
+    if (!tud_hid_n_report(instance, e->report_id, e->data, e->len)) return false;
+
+    hid_queue_t *q = &queues[instance];
+    q->inflight_seq = e->seq;
+    if (e->flags & HID_QUEUE_FLAG_BITMAP) {
+        q->last_bitmap = *e;
+        q->last_bitmap_valid = true;
+    }
+    return true;
+}
+
+// Replacing queued state T by newer state N is safe only if no bit that
+// changed going into T changes back in N: ((P ^ T) & (T ^ N)) == 0, where P
+// is the state the host sees just before T.
+static bool can_coalesce(const hid_queue_entry_t *p, const hid_queue_entry_t *t,
+                         const uint8_t *n, uint16_t len)
+{
+    if (p->report_id != t->report_id || p->len != len || t->len != len) return false;
+    for (uint16_t i = 0; i < len; i++) {
+        if ((uint8_t)((p->data[i] ^ t->data[i]) & (t->data[i] ^ n[i])) != 0) return false;
+    }
+    return true;
+}
+
+static void drain(uint8_t instance)
+{
+    hid_queue_t *q = &queues[instance];
+    if (q->count == 0) return;
+    if (!transmit(instance, entry_at(q, 0))) return;
+    q->head = (uint8_t)((q->head + 1) % HID_QUEUE_DEPTH);
+    q->count--;
+}
+
+void hid_queue_init(void)
+{
+    memset(queues, 0, sizeof(queues));
+    memset(idle_handlers, 0, sizeof(idle_handlers));
+    memset(complete_handlers, 0, sizeof(complete_handlers));
+}
+
+bool hid_queue_send(uint8_t instance, uint8_t report_id, const void *data, uint16_t len, uint8_t flags)
+{
+    if (instance >= HID_QUEUE_INSTANCES || len > HID_QUEUE_MAX_REPORT) return false;
+    hid_queue_t *q = &queues[instance];
+
+    hid_queue_entry_t e;
+    e.report_id = report_id;
+    e.flags = flags;
+    e.len = (uint8_t)len;
+    e.seq = ++q->next_seq;
+    memcpy(e.data, data, len);
+
+    // Fast path: nothing waiting and the endpoint is free
+    if (q->count == 0 && transmit(instance, &e)) return true;
+
+    // Merge state reports into the queued tail when that keeps every
+    // transition visible. Anything else (a raw response) is a distinct reply.
+    const uint8_t state_flags = HID_QUEUE_FLAG_STATE | HID_QUEUE_FLAG_BITMAP;
+    if (q->count > 0 && (flags & state_flags)) {
+        hid_queue_entry_t *t = entry_at(q, (uint8_t)(q->count - 1));
+        if (t->report_id == report_id && t->len == len && (t->flags & state_flags)) {
+            if (memcmp(t->data, data, len) == 0) {
+                t->seq = e.seq;
+                q->stats.coalesced++;
+                return true;  // identical to what is already queued
+            }
+            if ((flags & HID_QUEUE_FLAG_BITMAP) && (t->flags & HID_QUEUE_FLAG_BITMAP)) {
+                const hid_queue_entry_t *p = NULL;
+                if (q->count >= 2) p = entry_at(q, (uint8_t)(q->count - 2));
+                else if (q->last_bitmap_valid) p = &q->last_bitmap;
+                if (p && can_coalesce(p, t, e.data, len)) {
+                    memcpy(t->data, data, len);
+                    t->seq = e.seq;
+                    q->stats.coalesced++;
+                    return true;
+                }
+            }
+        }
+    }
+
+    if (q->count >= HID_QUEUE_DEPTH) {
+        q->stats.dropped++;
+        return false;
+    }
+
+    *entry_at(q, q->count) = e;
+    q->count++;
+    q->stats.queued++;
+    return true;
+}
+
+void hid_queue_task(void)
+{
+    for (uint8_t i = 0; i < HID_QUEUE_INSTANCES; i++) {
+        drain(i);
+    }
+}
+
+uint32_t hid_queue_last_seq(uint8_t instance)
+{
+    if (instance >= HID_QUEUE_INSTANCES) return 0;
+    return queues[instance].next_seq;
+}
+
+bool hid_queue_pending(uint8_t instance)
+{
+    if (instance >= HID_QUEUE_INSTANCES) return false;
+    return queues[instance].count > 0;
+}
+
+void hid_queue_flush(uint32_t timeout_ms)
+{
+    const absolute_time_t deadline = make_timeout_time_ms(timeout_ms);
+    for (;;) {
+        bool pending = false;
+        for (uint8_t i = 0; i < HID_QUEUE_INSTANCES; i++) {
+            if (queues[i].count > 0) pending = true;
+        }
+        if (!pending || time_reached(deadline)) return;
+        tud_task();
+        hid_queue_task();
+    }
+}
+
+void hid_queue_get_stats(uint8_t instance, hid_queue_stats_t *out)
+{
+    if (!out) return;
+    if (instance >= HID_QUEUE_INSTANCES) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    *out = queues[instance].stats;
+}
+
+bool hid_queue_add_idle_handler(uint8_t instance, hid_queue_idle_cb_t cb)
+{
+    if (instance >= HID_QUEUE_INSTANCES || !cb) return false;
+    for (uint8_t i = 0; i < HID_QUEUE_IDLE_HANDLERS; i++) {
+        if (idle_handlers[instance][i] == cb) return true;
+        if (!idle_handlers[instance][i]) {
+            idle_handlers[instance][i] = cb;
+            return true;
+        }
+    }
+    return false;
+}
+
+void hid_queue_set_complete_handler(uint8_t instance, hid_queue_complete_cb_t cb)
+{
+    if (instance < HID_QUEUE_INSTANCES) complete_handlers[instance] = cb;
+}
+
+// TinyUSB: previous IN report on this interface was delivered
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len)
+{
+    (void)report; (void)len;
+    if (instance >= HID_QUEUE_INSTANCES) return;
+    // Before drain(), which puts the next report on the endpoint
+    if (complete_handlers[instance]) {
+        complete_handlers[instance](instance, queues[instance].inflight_seq);
+    }
+    drain(instance);
+    for (uint8_t i = 0; i < HID_QUEUE_IDLE_HANDLERS; i++) {
+        if (queues[instance].count != 0 || !idle_handlers[instance][i]) break;
+        idle_handlers[instance][i](instance);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef HID_QUEUE_H
+#define HID_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Per-interface IN report queue. Reports that cannot go out immediately are
+// queued and sent from tud_hid_report_complete_cb, so a busy endpoint never
+// loses a press or release.
+
+#ifndef HID_QUEUE_DEPTH
+#define HID_QUEUE_DEPTH 8          // reports per interface
+#endif
+#define HID_QUEUE_INSTANCES 4      // keyboard, VIA raw, app raw, response raw
+#define HID_QUEUE_MAX_REPORT 64
+#define HID_QUEUE_IDLE_HANDLERS 2  // per interface (raw_tx, ADC snapshot stream)
+
+// Send flags
+// Never merged: every send reaches the host (raw responses, mouse movement)
+#define HID_QUEUE_FLAG_NONE    0x00
+// Report is a state bitmap (modifiers + NKRO bits): a queued, not yet sent
+// report of the same ID may be replaced when that cannot hide a transition.
+// Implies HID_QUEUE_FLAG_STATE.
+#define HID_QUEUE_FLAG_BITMAP  0x01
+// Report is absolute state (keyboard, consumer, system, mouse buttons): a send
+// identical to the queued tail adds nothing and is merged into it.
+#define HID_QUEUE_FLAG_STATE   0x02
+
+typedef struct {
+    uint32_t queued;     // reports that had to wait for the endpoint
+    uint32_t coalesced;  // queued reports merged into a newer state
+    uint32_t dropped;    // reports refused because the queue was full
+} hid_queue_stats_t;
+
+void hid_queue_init(void);
+
+// Send now if the interface is idle, otherwise queue. Returns false only if
+// the report was dropped (queue full and not coalescable).
+bool hid_queue_send(uint8_t instance, uint8_t report_id, const void *data, uint16_t len, uint8_t flags);
+
+// Kick any queue whose endpoint is idle (call from the main loop)
+void hid_queue_task(void);
+
+// Sequence number of the last hid_queue_send() on this interface. A queued
+// report that absorbs a newer send (coalescing) takes the newer number, so
+// the number passed to the complete handler covers every send up to it.
+uint32_t hid_queue_last_seq(uint8_t instance);
+
+// True if reports are waiting on this interface
+bool hid_queue_pending(uint8_t instance);
+
+// Run TinyUSB until every queue is empty or timeout_ms passes (use before
+// a reboot, when the main loop will not get another chance to drain)
+void hid_queue_flush(uint32_t timeout_ms);
+
+void hid_queue_get_stats(uint8_t instance, hid_queue_stats_t *out);
+
+// Called when an interface's queue runs empty after a completed report, so
+// a producer with more data (raw_tx, ADC snapshots) can refill it from the
+// callback. Handlers run in registration order; once one has put a report on
+// the endpoint, the ones after it find the interface busy and wait their turn.
+typedef void (*hid_queue_idle_cb_t)(uint8_t instance);
+bool hid_queue_add_idle_handler(uint8_t instance, hid_queue_idle_cb_t cb);
+
+// Called when a report has been delivered, with its sequence number
+typedef void (*hid_queue_complete_cb_t)(uint8_t instance, uint32_t seq);
+void hid_queue_set_complete_handler(uint8_t instance, hid_queue_complete_cb_t cb);
+
+#endif // HID_QUEUE_H
@@ -8,6 +8,18 @@
 #include "lighting.h"
 #include "profiles.h"
 #include "socd.h"
+#include "midi.h"
+#include "two_stage.h"
+#include "layer_actuation.h"
+#include "hid_queue.h"
+#include "hid_cmd.h"
+#include "adc_snapshot.h"
+#include "raw_tx.h"
+#include "config_image.h"
+#include "sof_align.h"
+#include "latency.h"
+#include "mouse.h"
+#include "notify.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -15,66 +27,211 @@
 extern uint8_t (*get_keymap_ptr(void))[SENSOR_COUNT];
 extern uint8_t keymap_get_keycount(void);
 
-// Internal state flags for deferred processing
-static volatile bool flag_led_power_toggle = false;
-static volatile int flag_led_power_set = -1;
-static volatile bool flag_socd_toggle = false;
-static volatile int flag_socd_set = -1;
-static volatile int flag_brightness_set = -1;
-static volatile bool flag_actuation_set = false;
-static volatile uint8_t actuation_key_idx = 0;
-static volatile uint8_t actuation_threshold = 0;
-static volatile int flag_layer_set = -1;
-static volatile bool flag_keymap_set = false;
-static volatile uint8_t keymap_layer = 0;
-static volatile uint8_t keymap_key_idx = 0;
-static volatile uint8_t keymap_keycode = 0;
-static volatile bool flag_calibrate = false;
-static volatile bool flag_bootloader = false;
-static volatile bool flag_save_profile = false;
-static volatile bool flag_load_profile = false;
+// Latest-wins state for deferred processing. Everything else the main loop
+// must act on goes through the hid_cmd ring.
 static volatile bool flag_settings_changed = false;  // Mark that settings need to be saved to flash
 static volatile bool flag_led_update = false;
 static uint8_t led_update_buffer[LED_COUNT * 3];
 
-// Modern profile commands (deferred; handled in main loop)
-static volatile bool flag_profile_save = false;
-static volatile bool flag_profile_load = false;
-static volatile bool flag_profile_delete = false;
-static volatile bool flag_profile_blank = false;
-static volatile uint8_t profile_slot = 0;
-
 // Chunked LED update state
 static uint8_t led_chunk_buffer[LED_COUNT * 3];
 static bool led_chunking_active = false;
 
-// ADC streaming state
-static volatile bool flag_adc_stream_enable = false;
-static volatile bool adc_stream_enabled = false;
-static volatile bool flag_get_key_adc = false;
-static volatile uint8_t get_key_adc_idx = 0;
-
-// Advanced calibration state (deferred; handled in main loop)
-static volatile bool flag_set_adv_cal_enabled = false;
-static volatile bool adv_cal_enabled_req = false;
-static volatile bool flag_set_adv_cal_key = false;
-static volatile uint8_t adv_cal_key_idx = 0;
-static volatile uint16_t adv_cal_release_adc = 0;
-static volatile uint16_t adv_cal_press_adc = 0;
-static volatile bool flag_get_adv_cal_key = false;
-static volatile uint8_t get_adv_cal_key_idx = 0;
-
 // Status reporting
 static uint8_t status_flags = 0;
 static uint8_t current_layer = 0;
-static bool key_states[128] = {0};  // Max 128 keys
-static size_t key_count = 0;
 
 // Track last RAW HID interface instance used by the host
 // With 4-interface structure: 0=kbd, 1=VIA, 2=AppRaw, 3=RespRaw
 // Default to 2 (App Raw) since that's what the software uses
 static volatile uint8_t last_raw_instance = 2;
 
+// Protocol version announced by the host in CMD_GET_CAPABILITIES (0 = never
+// asked: legacy host)
+static uint16_t host_protocol = 0;
+
+// Command codes handled by hid_raw_receive, as inclusive ranges. Keep in
+// step with the switch below; commands that never reply (CMD_GET_ACTUATION
+// is still a stub) are left out.
+static const uint8_t cmd_ranges[][2] = {
+    { 0x02, 0x04 }, { 0x06, 0x08 }, { 0x0A, 0x11 }, { 0x13, 0x1C }, { 0x1F, 0x21 },
+    { 0x23, 0x28 }, { 0x36, 0x3D }, { 0x40, 0x5B }, { 0x60, 0x63 },
+    { 0x68, 0x76 }, { 0x7A, 0x7C },
+};
+
+// ---------------------------------------------------------------------------
+// Multi-record response generators (raw_tx jobs)
+// ---------------------------------------------------------------------------
+
+// RESP_MODIFIED_KEY record: [layer, key_idx, keycode], cursor = layer * SENSOR_COUNT + key
+static bool next_modified_key(raw_tx_job_t *job, uint8_t *rec)
+{
+    uint8_t (*km)[SENSOR_COUNT] = get_keymap_ptr();
+    if (!km) return false;
+    while (job->cursor < (uint16_t)(MAX_LAYERS * SENSOR_COUNT)) {
+        const uint8_t layer = (uint8_t)(job->cursor / SENSOR_COUNT);
+        const uint8_t key_idx = (uint8_t)(job->cursor % SENSOR_COUNT);
+        job->cursor++;
+        const uint8_t v = km[layer][key_idx];
+        if (v == 0) continue;
+        rec[0] = layer;
+        rec[1] = key_idx;
+        rec[2] = v;
+        return true;
+    }
+    return false;
+}
+
+// RESP_SOCD_PAIR record: [pair_idx, key1_idx, key2_idx, mode, valid]
+static bool next_socd_pair(raw_tx_job_t *job, uint8_t *rec)
+{
+    if (job->cursor >= SOCD_MAX_PAIRS) return false;
+    const uint8_t i = (uint8_t)job->cursor++;
+    socd_pair_t pair;
+    bool valid = socd_get_pair(i, &pair);
+    rec[0] = i;
+    rec[1] = valid ? pair.key1_idx : 0;
+    rec[2] = valid ? pair.key2_idx : 0;
+    rec[3] = valid ? pair.mode : 0;
+    rec[4] = valid ? 1 : 0;
+    return true;
+}
+
+// RESP_PROFILE_INFO record: [slot, valid, r, g, b, static_indicator]
+static bool next_profile_info(raw_tx_job_t *job, uint8_t *rec)
+{
+    if (job->cursor >= 10) return false;
+    const uint8_t slot = (uint8_t)job->cursor++;
+    rec[0] = slot;
+    rec[1] = profiles_slot_valid(slot) ? 1 : 0;
+    profiles_get_slot_color(slot, &rec[2], &rec[3], &rec[4]);
+    rec[5] = profiles_static_indicator_enabled() ? 1 : 0;
+    return true;
+}
+
+// RESP_GET_KEYMAP_CHUNK record: [layer, total, offset, count, k...], cursor = offset
+#define KEYMAP_CHUNK_MAX 59  // 5-byte header on 64B report
+static bool next_keymap_chunk(raw_tx_job_t *job, uint8_t *rec)
+{
+    uint8_t (*km)[SENSOR_COUNT] = get_keymap_ptr();
+    const uint8_t total = keymap_get_keycount();
+    if (!km || job->cursor >= total) return false;
+    const uint8_t offset = (uint8_t)job->cursor;
+    uint8_t count = (uint8_t)(total - offset);
+    if (count > KEYMAP_CHUNK_MAX) count = KEYMAP_CHUNK_MAX;
+    rec[0] = job->arg;
+    rec[1] = total;
+    rec[2] = offset;
+    rec[3] = count;
+    for (uint8_t i = 0; i < count; i++) {
+        rec[4 + i] = km[job->arg][(uint8_t)(offset + i)];
+    }
+    job->cursor += count;
+    return true;
+}
+
+// RESP_CAPABILITIES:
+//   [version u16, sensor_count, led_count u16, max_layers, features u16,
+//    cmd_queue_depth, raw_jobs, max_record, batch_payload, adc_stream_keys,
+//    adc_snapshot_values, keymap_chunk, config_chunk, config_max u16,
+//    range_count, (first, last) * range_count]
+static void hid_send_capabilities(uint8_t instance)
+{
+    uint16_t features = 0;
+    if (NKRO_ENABLE) features |= HID_CAP_NKRO;
+    if (MIDI_ENABLE) features |= HID_CAP_MIDI;
+    if (MOUSE_ENABLE) features |= HID_CAP_MOUSE;
+    if (RGB_ENABLE) features |= HID_CAP_RGB;
+    if (ENCODER_ENABLE) features |= HID_CAP_ENCODER;
+    if (DISPLAY_ENABLE) features |= HID_CAP_DISPLAY;
+    if (CAPS_LOCK_INDICATOR) features |= HID_CAP_CAPS_INDICATOR;
+
+    uint8_t resp[64] = {0};
+    resp[0] = RESP_CAPABILITIES;
+    resp[1] = (uint8_t)(HID_PROTOCOL_VERSION & 0xFF);
+    resp[2] = (uint8_t)(HID_PROTOCOL_VERSION >> 8);
+    resp[3] = (uint8_t)SENSOR_COUNT;
+    resp[4] = (uint8_t)(LED_COUNT & 0xFF);
+    resp[5] = (uint8_t)((LED_COUNT >> 8) & 0xFF);
+    resp[6] = MAX_LAYERS;
+    resp[7] = (uint8_t)(features & 0xFF);
+    resp[8] = (uint8_t)(features >> 8);
+    resp[9] = HID_CMD_QUEUE_DEPTH;
+    resp[10] = RAW_TX_JOB_DEPTH;
+    resp[11] = RAW_TX_MAX_RECORD;
+    resp[12] = sizeof(resp) - RAW_TX_BATCH_HEADER_LEN;
+    resp[13] = (sizeof(resp) - 2) / 4;
+    resp[14] = ADC_SNAPSHOT_VALUES_PER_REPORT;
+    resp[15] = KEYMAP_CHUNK_MAX;
+    resp[16] = CONFIG_IMAGE_CHUNK;
+    resp[17] = (uint8_t)(CONFIG_IMAGE_MAX_BYTES & 0xFF);
+    resp[18] = (uint8_t)((CONFIG_IMAGE_MAX_BYTES >> 8) & 0xFF);
+
+    const uint8_t n = (uint8_t)(sizeof(cmd_ranges) / sizeof(cmd_ranges[0]));
+    resp[19] = n;
+    for (uint8_t i = 0; i < n; i++) {
+        resp[20 + i * 2] = cmd_ranges[i][0];
+        resp[21 + i * 2] = cmd_ranges[i][1];
+    }
+    hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+}
+
+void hid_reset_host_protocol(void)
+{
+    host_protocol = 0;
+}
+
+// Queue a command for the main loop. If the ring is full the host is told
+// which command was refused so it can pace itself instead of losing a write.
+static void queue_cmd(uint8_t instance, uint8_t cmd_code, hid_cmd_t *c)
+{
+    c->instance = instance;
+    if (hid_cmd_push(c)) return;
+
+    hid_cmd_stats_t st;
+    hid_cmd_get_stats(&st);
+    uint8_t resp[64] = {0};
+    resp[0] = RESP_CMD_OVERFLOW;
+    resp[1] = cmd_code;
+    resp[2] = (uint8_t)(st.dropped & 0xFF);
+    resp[3] = (uint8_t)((st.dropped >> 8) & 0xFF);
+    hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+}
+
+// Payload-less command
+static void queue_simple(uint8_t instance, uint8_t cmd_code, hid_cmd_type_t type)
+{
+    hid_cmd_t c = { .type = (uint8_t)type };
+    queue_cmd(instance, cmd_code, &c);
+}
+
+// Command with a single byte argument
+static void queue_u8(uint8_t instance, uint8_t cmd_code, hid_cmd_type_t type, uint8_t value)
+{
+    hid_cmd_t c = { .type = (uint8_t)type, .u8 = value };
+    queue_cmd(instance, cmd_code, &c);
+}
+
+// Start a multi-record response; a full job queue is reported like a full
+// command ring so the host can retry the request.
+static bool start_job(uint8_t instance, uint8_t cmd_code, uint8_t resp_code, uint8_t record_len,
+                      raw_tx_next_fn next, uint8_t arg, uint16_t cursor)
+{
+    static uint16_t jobs_refused = 0;
+    const raw_tx_job_t job = { .resp_code = resp_code, .record_len = record_len,
+                               .arg = arg, .cursor = cursor, .next = next };
+    if (raw_tx_start(instance, &job)) return true;
+
+    jobs_refused++;
+    uint8_t resp[64] = {0};
+    resp[0] = RESP_CMD_OVERFLOW;
+    resp[1] = cmd_code;
+    resp[2] = (uint8_t)(jobs_refused & 0xFF);
+    resp[3] = (uint8_t)(jobs_refused >> 8);
+    hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+    return false;
+}
+
 void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer, uint16_t len)
 {
     // 'instance' identifies which HID interface (kbd vs vendor RAW) invoked us.
@@ -99,22 +256,22 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
     
     switch (cmd) {
         case CMD_TOGGLE_LED_POWER:
-            flag_led_power_toggle = true;
+            queue_simple(instance, cmd, HID_CMD_LED_POWER_TOGGLE);
             break;
             
         case CMD_SET_LED_POWER:
             if (data_len >= 1) {
-                flag_led_power_set = data[0] ? 1 : 0;
+                queue_u8(instance, cmd, HID_CMD_LED_POWER_SET, data[0] ? 1 : 0);
             }
             break;
             
         case CMD_TOGGLE_SOCD:
-            flag_socd_toggle = true;
+            queue_simple(instance, cmd, HID_CMD_SOCD_TOGGLE);
             break;
 
         case CMD_SET_SOCD:
             if (data_len >= 1) {
-                flag_socd_set = data[0] ? 1 : 0;
+                queue_u8(instance, cmd, HID_CMD_SOCD_SET, data[0] ? 1 : 0);
             }
             break;
 
@@ -148,9 +305,7 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
                 resp[3] = valid ? pair.key2_idx : 0;
                 resp[4] = valid ? pair.mode : 0;
                 resp[5] = valid ? 1 : 0;
-                if (tud_hid_n_ready(instance)) {
-                    tud_hid_n_report(instance, REPORT_ID_RAW, resp, sizeof(resp));
-                }
+                hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
             }
             break;
         }
@@ -170,21 +325,7 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
         case CMD_GET_ALL_SOCD_PAIRS: {
             // Get all SOCD pairs -> send RESP_SOCD_PAIR for each
             printf("[HID] CMD_GET_ALL_SOCD_PAIRS\n");
-            for (uint8_t i = 0; i < SOCD_MAX_PAIRS; i++) {
-                socd_pair_t pair;
-                bool valid = socd_get_pair(i, &pair);
-
-                uint8_t resp[64] = {0};
-                resp[0] = RESP_SOCD_PAIR;
-                resp[1] = i;
-                resp[2] = valid ? pair.key1_idx : 0;
-                resp[3] = valid ? pair.key2_idx : 0;
-                resp[4] = valid ? pair.mode : 0;
-                resp[5] = valid ? 1 : 0;
-                if (tud_hid_n_ready(instance)) {
-                    tud_hid_n_report(instance, REPORT_ID_RAW, resp, sizeof(resp));
-                }
-            }
+            start_job(instance, cmd, RESP_SOCD_PAIR, 5, next_socd_pair, 0, 0);
             break;
         }
 
@@ -205,17 +346,362 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
             resp[0] = RESP_SOCD_MODE;
             resp[1] = socd_get_global_mode();
             resp[2] = socd_get_enabled() ? 1 : 0;
-            if (tud_hid_n_ready(instance)) {
-                tud_hid_n_report(instance, REPORT_ID_RAW, resp, sizeof(resp));
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+            break;
+        }
+
+        case CMD_SET_MIDI_MODE:
+            // [enabled, channel, aftertouch]
+            if (data_len >= 3) {
+                midi_set_channel(data[1]);
+                midi_set_aftertouch(data[2] ? true : false);
+                midi_set_enabled(data[0] ? true : false);
+                flag_settings_changed = true;
+            }
+            break;
+
+        case CMD_GET_MIDI_MODE: {
+            uint8_t resp[64] = {0};
+            resp[0] = RESP_MIDI_MODE;
+            resp[1] = MIDI_ENABLE ? 1 : 0;
+            resp[2] = midi_get_enabled() ? 1 : 0;
+            resp[3] = midi_get_channel();
+            resp[4] = midi_get_aftertouch() ? 1 : 0;
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+            break;
+        }
+
+        case CMD_SET_MIDI_NOTE:
+            // [key_idx, note]
+            if (data_len >= 2) {
+                if (midi_set_note(data[0], data[1])) {
+                    flag_settings_changed = true;
+                }
+            }
+            break;
+
+        case CMD_GET_MIDI_NOTES: {
+            // [offset] -> RESP_MIDI_NOTES [total, offset, count, notes...]
+            const uint8_t total = (uint8_t)SENSOR_COUNT;
+            const uint8_t offset0 = (data_len >= 1) ? data[0] : 0;
+            const uint8_t maxChunk = 60; // 4-byte header on 64B report
+            uint8_t resp[64] = {0};
+            resp[0] = RESP_MIDI_NOTES;
+            resp[1] = total;
+            resp[2] = offset0;
+            uint8_t count = 0;
+            if (offset0 < total) {
+                count = (uint8_t)((total - offset0) > maxChunk ? maxChunk : (total - offset0));
+            }
+            resp[3] = count;
+            for (uint8_t i = 0; i < count; i++) {
+                resp[4 + i] = midi_get_note((uint8_t)(offset0 + i));
+            }
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+            break;
+        }
+
+        case CMD_SET_TWO_STAGE_KEY:
+            // [key_idx, actuation_pct, hysteresis_pct, mode]
+            if (data_len >= 4) {
+                if (two_stage_set_key(data[0], data[1], data[2], data[3])) {
+                    flag_settings_changed = true;
+                }
+            }
+            break;
+
+        case CMD_GET_TWO_STAGE_KEY: {
+            // [key_idx] -> RESP_TWO_STAGE_KEY
+            two_stage_key_t cfg;
+            const uint8_t key_idx = (data_len >= 1) ? data[0] : 0;
+            if (!two_stage_get_key(key_idx, &cfg)) break;
+            uint8_t resp[64] = {0};
+            resp[0] = RESP_TWO_STAGE_KEY;
+            resp[1] = key_idx;
+            resp[2] = cfg.actuation;
+            resp[3] = cfg.hysteresis;
+            resp[4] = cfg.mode;
+            for (uint8_t layer = 0; layer < MAX_LAYERS; layer++) {
+                resp[5 + layer] = two_stage_get_keycode(layer, key_idx);
+            }
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+            break;
+        }
+
+        case CMD_SET_TWO_STAGE_KEYCODE:
+            // [layer, key_idx, keycode]
+            if (data_len >= 3) {
+                if (two_stage_set_keycode(data[0], data[1], data[2])) {
+                    flag_settings_changed = true;
+                }
+            }
+            break;
+
+        case CMD_SET_LAYER_ACTUATION:
+            // [layer, key_idx (0xFF = all), actuation_pct, hysteresis_pct]
+            if (data_len >= 4) {
+                bool ok;
+                if (data[1] == 0xFF) {
+                    // Succeeds only if every key took the values
+                    ok = true;
+                    for (uint8_t i = 0; i < SENSOR_COUNT; i++) {
+                        ok &= layer_actuation_set_key(data[0], i, data[2], data[3]);
+                    }
+                } else {
+                    ok = layer_actuation_set_key(data[0], data[1], data[2], data[3]);
+                }
+                if (ok) flag_settings_changed = true;
+            }
+            break;
+
+        case CMD_SET_LAYER_ACTUATION_ENABLED:
+            // [layer, enabled]
+            if (data_len >= 2) {
+                if (layer_actuation_set_enabled(data[0], data[1] ? true : false)) {
+                    flag_settings_changed = true;
+                }
+            }
+            break;
+
+        case CMD_GET_LAYER_ACTUATION: {
+            // [layer, offset] -> RESP_LAYER_ACTUATION [layer, enabled, total, offset, count, (act, hyst)*]
+            const uint8_t layer = (data_len >= 1) ? data[0] : 1;
+            const uint8_t total = (uint8_t)SENSOR_COUNT;
+            const uint8_t offset0 = (data_len >= 2) ? data[1] : 0;
+            const uint8_t maxChunk = 29; // 6-byte header + 2 bytes per key on 64B report
+            uint8_t resp[64] = {0};
+            resp[0] = RESP_LAYER_ACTUATION;
+            resp[1] = layer;
+            resp[2] = layer_actuation_get_enabled(layer) ? 1 : 0;
+            resp[3] = total;
+            resp[4] = offset0;
+            uint8_t count = 0;
+            if (offset0 < total) {
+                count = (uint8_t)((total - offset0) > maxChunk ? maxChunk : (total - offset0));
+            }
+            resp[5] = count;
+            for (uint8_t i = 0; i < count; i++) {
+                layer_actuation_get_key(layer, (uint8_t)(offset0 + i), &resp[6 + i * 2], &resp[7 + i * 2]);
+            }
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+            break;
+        }
+
+        case CMD_GET_HID_QUEUE_STATS: {
+            uint8_t resp[64] = {0};
+            resp[0] = RESP_HID_QUEUE_STATS;
+            resp[1] = HID_QUEUE_INSTANCES;
+            uint8_t pos = 2;
+            for (uint8_t i = 0; i < HID_QUEUE_INSTANCES; i++) {
+                hid_queue_stats_t st;
+                hid_queue_get_stats(i, &st);
+                const uint32_t vals[3] = { st.queued, st.coalesced, st.dropped };
+                for (uint8_t v = 0; v < 3; v++) {
+                    resp[pos++] = (uint8_t)(vals[v] & 0xFF);
+                    resp[pos++] = (uint8_t)((vals[v] >> 8) & 0xFF);
+                    resp[pos++] = (uint8_t)((vals[v] >> 16) & 0xFF);
+                    resp[pos++] = (uint8_t)((vals[v] >> 24) & 0xFF);
+                }
+            }
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+            break;
+        }
+
+        case CMD_SET_ADC_SNAPSHOT:
+            // [enabled, interval_ms, mask...]
+            if (data_len >= 1) {
+                const uint8_t interval = (data_len >= 2) ? data[1] : 0;
+                const uint8_t mask_len = (data_len > 2) ? (uint8_t)(data_len - 2) : 0;
+                adc_snapshot_configure(data[0] != 0, interval, mask_len ? &data[2] : NULL, mask_len);
+            }
+            break;
+
+        case CMD_GET_CONFIG_IMAGE: {
+            raw_tx_job_t job;
+            if (config_image_read_job(&job)) {
+                if (!start_job(instance, cmd, job.resp_code, job.record_len, job.next, job.arg, job.cursor)) {
+                    config_image_read_abort();
+                }
+            } else {
+                hid_send_config_status(instance, cmd, CONFIG_STATUS_BUSY);
+            }
+            break;
+        }
+
+        case CMD_CONFIG_WRITE_BEGIN:
+            // [total u32]
+            if (data_len >= 4) {
+                const uint32_t total = (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+                                       ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+                hid_send_config_status(instance, cmd, config_image_write_begin(total));
+            }
+            break;
+
+        case CMD_CONFIG_WRITE_CHUNK:
+            // [seq u16, len, data...]; silent on success so the host can stream
+            if (data_len >= 3) {
+                const uint16_t seq = (uint16_t)(data[0] | (data[1] << 8));
+                uint8_t n = data[2];
+                if (n > data_len - 3) n = (uint8_t)(data_len - 3);
+                const config_status_t st = config_image_write_chunk(seq, &data[3], n);
+                if (st != CONFIG_STATUS_OK) hid_send_config_status(instance, cmd, st);
+            }
+            break;
+
+        case CMD_CONFIG_WRITE_COMMIT:
+            // [crc32 u32]: verify here, apply + flash write in the main loop
+            if (data_len >= 4) {
+                const uint32_t crc = (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+                                     ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+                const config_status_t st = config_image_write_verify(crc);
+                if (st == CONFIG_STATUS_OK) {
+                    queue_simple(instance, cmd, HID_CMD_CONFIG_COMMIT);
+                } else {
+                    hid_send_config_status(instance, cmd, st);
+                }
+            }
+            break;
+
+        case CMD_SET_RAW_BATCHING:
+            if (data_len >= 1) {
+                raw_tx_set_batching(data[0] != 0);
+            }
+            break;
+
+        case CMD_GET_RAW_BATCHING: {
+            uint8_t resp[64] = {0};
+            resp[0] = RESP_RAW_BATCHING;
+            resp[1] = raw_tx_get_batching() ? 1 : 0;
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+            break;
+        }
+
+        case CMD_SET_SOF_ALIGN:
+            // [enabled, margin_lo, margin_hi]
+            if (data_len >= 1) {
+                const uint16_t margin = (data_len >= 3) ? (uint16_t)(data[1] | (data[2] << 8))
+                                                        : SOF_ALIGN_MARGIN_US;
+                sof_align_set(data[0] != 0, margin);
+            }
+            break;
+
+        case CMD_GET_SOF_ALIGN: {
+            sof_align_stats_t st;
+            sof_align_get_stats(&st);
+            uint8_t resp[64] = {0};
+            resp[0] = RESP_SOF_ALIGN;
+            resp[1] = st.enabled ? 1 : 0;
+            resp[2] = st.locked ? 1 : 0;
+            resp[3] = (uint8_t)(st.margin_us & 0xFF);
+            resp[4] = (uint8_t)(st.margin_us >> 8);
+            resp[5] = (uint8_t)(st.scan_us & 0xFF);
+            resp[6] = (uint8_t)(st.scan_us >> 8);
+            resp[7] = (uint8_t)((uint16_t)st.lead_avg_us & 0xFF);
+            resp[8] = (uint8_t)((uint16_t)st.lead_avg_us >> 8);
+            resp[9] = (uint8_t)(st.lead_jitter_us & 0xFF);
+            resp[10] = (uint8_t)(st.lead_jitter_us >> 8);
+            for (uint8_t i = 0; i < 4; i++) {
+                resp[11 + i] = (uint8_t)((st.frames >> (8 * i)) & 0xFF);
+                resp[15 + i] = (uint8_t)((st.missed >> (8 * i)) & 0xFF);
+            }
+            resp[19] = (uint8_t)(st.period_us & 0xFF);
+            resp[20] = (uint8_t)(st.period_us >> 8);
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+            break;
+        }
+
+        case CMD_GET_LATENCY: {
+            // [reset]: freeze, reply with the summary, then stream the buckets
+            latency_snapshot(data_len >= 1 && data[0] != 0);
+            latency_stats_t st;
+            latency_get_stats(&st);
+            uint8_t resp[64] = {0};
+            resp[0] = RESP_LATENCY_STATS;
+            const uint32_t vals[5] = { st.samples, st.min_us, st.max_us, st.mean_us, st.overflow };
+            uint8_t pos = 1;
+            for (uint8_t v = 0; v < 5; v++) {
+                resp[pos++] = (uint8_t)(vals[v] & 0xFF);
+                resp[pos++] = (uint8_t)((vals[v] >> 8) & 0xFF);
+                resp[pos++] = (uint8_t)((vals[v] >> 16) & 0xFF);
+                resp[pos++] = (uint8_t)((vals[v] >> 24) & 0xFF);
+            }
+            resp[pos++] = (uint8_t)(LATENCY_BUCKET_US & 0xFF);
+            resp[pos++] = (uint8_t)(LATENCY_BUCKET_US >> 8);
+            resp[pos++] = LATENCY_BUCKETS;
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+
+            raw_tx_job_t job;
+            latency_hist_job(&job);
+            start_job(instance, cmd, job.resp_code, job.record_len, job.next, job.arg, job.cursor);
+            break;
+        }
+
+        case CMD_SET_MOUSE_CURVE:
+            // [curve, p0 u16 .. p4 u16]
+            if (data_len >= 1 + MOUSE_CURVE_POINTS * 2) {
+                uint16_t points[MOUSE_CURVE_POINTS];
+                for (uint8_t i = 0; i < MOUSE_CURVE_POINTS; i++) {
+                    points[i] = (uint16_t)(data[1 + i * 2] | (data[2 + i * 2] << 8));
+                }
+                if (mouse_set_curve(data[0], points)) {
+                    flag_settings_changed = true;
+                }
+            }
+            break;
+
+        case CMD_GET_MOUSE_CURVE: {
+            const uint8_t which = (data_len >= 1) ? data[0] : MOUSE_CURVE_MOVE;
+            uint16_t points[MOUSE_CURVE_POINTS];
+            mouse_get_curve(which, points);
+            uint8_t resp[64] = {0};
+            resp[0] = RESP_MOUSE_CURVE;
+            resp[1] = MOUSE_ENABLE ? 1 : 0;
+            resp[2] = which;
+            for (uint8_t i = 0; i < MOUSE_CURVE_POINTS; i++) {
+                resp[3 + i * 2] = (uint8_t)(points[i] & 0xFF);
+                resp[4 + i * 2] = (uint8_t)(points[i] >> 8);
+            }
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+            break;
+        }
+
+        case CMD_SET_EVENTS: {
+            if (data_len >= 1) {
+                notify_subscribe(instance, data[0]);
+            }
+            uint8_t resp[64] = {0};
+            resp[0] = RESP_EVENT_SUBSCRIPTION;
+            resp[1] = notify_get_mask();
+            resp[2] = NOTIFY_ALL;
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+            break;
+        }
+
+        case CMD_GET_CAPABILITIES:
+            // [host_version u16] (optional)
+            if (data_len >= 2) {
+                host_protocol = (uint16_t)(data[0] | (data[1] << 8));
             }
+            hid_send_capabilities(instance);
+            break;
+
+        case CMD_GET_ADC_SNAPSHOT: {
+            uint8_t resp[64] = {0};
+            resp[0] = RESP_ADC_SNAPSHOT_CONFIG;
+            resp[1] = adc_snapshot_get_enabled() ? 1 : 0;
+            resp[2] = adc_snapshot_get_interval();
+            resp[3] = adc_snapshot_get_key_count();
+            resp[4] = (uint8_t)SENSOR_COUNT;
+            adc_snapshot_get_mask(&resp[5]);
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
             break;
         }
 
         case CMD_SET_ACTUATION:
             if (data_len >= 2) {
-                actuation_key_idx = data[0];
-                actuation_threshold = data[1];
-                flag_actuation_set = true;
+                hid_cmd_t c = { .type = HID_CMD_ACTUATION_SET,
+                                .actuation = { .key_idx = data[0], .percent = data[1] } };
+                queue_cmd(instance, cmd, &c);
             }
             break;
             
@@ -226,10 +712,9 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
             
         case CMD_SET_KEYMAP_LEGACY:
             if (data_len >= 3) {
-                keymap_layer = data[0];
-                keymap_key_idx = data[1];
-                keymap_keycode = data[2];
-                flag_keymap_set = true;
+                hid_cmd_t c = { .type = HID_CMD_KEYMAP_SET,
+                                .keymap = { .layer = data[0], .key_idx = data[1], .keycode = data[2] } };
+                queue_cmd(instance, cmd, &c);
             }
             break;
 
@@ -253,10 +738,9 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
         case CMD_SET_KEYCODE:
             // [layer, key_idx, keycode]
             if (data_len >= 3) {
-                keymap_layer = data[0];
-                keymap_key_idx = data[1];
-                keymap_keycode = data[2];
-                flag_keymap_set = true;
+                hid_cmd_t c = { .type = HID_CMD_KEYMAP_SET,
+                                .keymap = { .layer = data[0], .key_idx = data[1], .keycode = data[2] } };
+                queue_cmd(instance, cmd, &c);
                 flag_settings_changed = true;  // Mark for flash save
             }
             break;
@@ -275,9 +759,7 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
             resp[1] = layer;
             resp[2] = key_idx;
             resp[3] = keycode;
-            if (tud_hid_n_ready(instance)) {
-                tud_hid_n_report(instance, REPORT_ID_RAW, resp, sizeof(resp));
-            }
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
             break;
         }
 
@@ -301,27 +783,21 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
                 for (uint8_t i = 0; i < n; i++) {
                     resp[2 + i] = km[layer][i];
                 }
-                if (tud_hid_n_ready(instance)) {
-                    tud_hid_n_report(instance, REPORT_ID_RAW, resp, sizeof(resp));
-                }
+                hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+            } else if (raw_tx_get_batching() && offset0 < total) {
+                // Batching hosts get every chunk from offset0 to the end for one request
+                start_job(instance, cmd, RESP_GET_KEYMAP_CHUNK, 4 + KEYMAP_CHUNK_MAX, next_keymap_chunk, layer, offset0);
             } else {
                 uint8_t resp[64] = {0};
                 resp[0] = RESP_GET_KEYMAP_CHUNK;
-                resp[1] = layer;
-                resp[2] = total;
-                resp[3] = offset0;
-                const uint8_t maxChunk = 59; // 5-byte header on 64B report
-                uint8_t count = 0;
-                if (offset0 < total) {
-                    count = (uint8_t)((total - offset0) > maxChunk ? maxChunk : (total - offset0));
-                }
-                resp[4] = count;
-                for (uint8_t i = 0; i < count; i++) {
-                    resp[5 + i] = km[layer][(uint8_t)(offset0 + i)];
-                }
-                if (tud_hid_n_ready(instance)) {
-                    tud_hid_n_report(instance, REPORT_ID_RAW, resp, sizeof(resp));
+                raw_tx_job_t one = { .arg = layer, .cursor = offset0 };
+                if (!next_keymap_chunk(&one, &resp[1])) {
+                    // Offset past the end: empty chunk
+                    resp[1] = layer;
+                    resp[2] = total;
+                    resp[3] = offset0;
                 }
+                hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
             }
             break;
         }
@@ -329,7 +805,7 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
         case CMD_SET_LAYER:
         case CMD_SET_LAYER_LEGACY:
             if (data_len >= 1 && data[0] < 4) {
-                flag_layer_set = data[0];
+                queue_u8(instance, cmd, HID_CMD_LAYER_SET, data[0]);
             }
             break;
 
@@ -337,9 +813,7 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
             uint8_t resp[64] = {0};
             resp[0] = RESP_GET_LAYER;
             resp[1] = current_layer;
-            if (tud_hid_n_ready(instance)) {
-                tud_hid_n_report(instance, REPORT_ID_RAW, resp, sizeof(resp));
-            }
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
             break;
         }
             
@@ -348,65 +822,45 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
             resp[0] = RESP_STATUS;
             resp[1] = status_flags;
             resp[2] = current_layer;
-            if (tud_hid_n_ready(instance)) {
-                tud_hid_n_report(instance, REPORT_ID_RAW, resp, sizeof(resp));
-            }
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
             break;
         }
             
         case CMD_SAVE_PROFILE_LEGACY:
-            flag_save_profile = true;
+            queue_simple(instance, cmd, HID_CMD_SAVE_SETTINGS);
             break;
 
         case CMD_LOAD_PROFILE_LEGACY:
-            flag_load_profile = true;
+            queue_simple(instance, cmd, HID_CMD_LOAD_SETTINGS);
             break;
 
         case CMD_SAVE_PROFILE:
             if (data_len >= 1) {
-                profile_slot = data[0];
-                flag_profile_save = true;
+                queue_u8(instance, cmd, HID_CMD_PROFILE_SAVE, data[0]);
             }
             break;
 
         case CMD_LOAD_PROFILE:
             if (data_len >= 1) {
-                profile_slot = data[0];
-                flag_profile_load = true;
+                queue_u8(instance, cmd, HID_CMD_PROFILE_LOAD, data[0]);
             }
             break;
 
         case CMD_DELETE_PROFILE:
             if (data_len >= 1) {
-                profile_slot = data[0];
-                flag_profile_delete = true;
+                queue_u8(instance, cmd, HID_CMD_PROFILE_DELETE, data[0]);
             }
             break;
 
         case CMD_CREATE_BLANK_PROFILE:
             if (data_len >= 1) {
-                profile_slot = data[0];
-                flag_profile_blank = true;
+                queue_u8(instance, cmd, HID_CMD_PROFILE_BLANK, data[0]);
             }
             break;
 
         case CMD_GET_PROFILE_LIST: {
             // Send RESP_PROFILE_INFO for all slots.
-            for (uint8_t slot = 0; slot < 10; slot++) {
-                uint8_t resp[64] = {0};
-                resp[0] = RESP_PROFILE_INFO;
-                resp[1] = slot;
-                resp[2] = profiles_slot_valid(slot) ? 1 : 0;
-                uint8_t r = 0, g = 0, b = 0;
-                profiles_get_slot_color(slot, &r, &g, &b);
-                resp[3] = r;
-                resp[4] = g;
-                resp[5] = b;
-                resp[6] = profiles_static_indicator_enabled() ? 1 : 0;
-                if (tud_hid_n_ready(last_raw_instance)) {
-                    tud_hid_n_report(last_raw_instance, REPORT_ID_RAW, resp, sizeof(resp));
-                }
-            }
+            start_job(instance, cmd, RESP_PROFILE_INFO, 6, next_profile_info, 0, 0);
             break;
         }
 
@@ -416,9 +870,7 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
             resp[1] = profiles_get_current_slot();
             resp[2] = 0; // lighting profile unsupported
             resp[3] = profiles_static_indicator_enabled() ? 1 : 0;
-            if (tud_hid_n_ready(last_raw_instance)) {
-                tud_hid_n_report(last_raw_instance, REPORT_ID_RAW, resp, sizeof(resp));
-            }
+            hid_queue_send(last_raw_instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
             break;
         }
 
@@ -446,37 +898,19 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
             uint8_t resp[3] = {0};
             resp[0] = RESP_SIGNALRGB_ZONES;
             resp[1] = lighting_get_streaming_zones();
-            if (tud_hid_n_ready(instance)) {
-                tud_hid_n_report(instance, REPORT_ID_RAW, resp, sizeof(resp));
-            }
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
             break;
         }
 
         case CMD_GET_MODIFIED_KEYS: {
             // Send one RESP_MODIFIED_KEY per modified entry (km[layer][idx] != 0)
-            uint8_t (*km)[SENSOR_COUNT] = get_keymap_ptr();
-            if (!km) break;
-            for (uint8_t layer = 0; layer < MAX_LAYERS; layer++) {
-                for (uint8_t key_idx = 0; key_idx < SENSOR_COUNT; key_idx++) {
-                    const uint8_t v = km[layer][key_idx];
-                    if (v == 0) continue;
-                    uint8_t resp[64] = {0};
-                    resp[0] = RESP_MODIFIED_KEY;
-                    resp[1] = layer;
-                    resp[2] = key_idx;
-                    resp[3] = v;
-                    if (tud_hid_n_ready(instance)) {
-                        tud_hid_n_report(instance, REPORT_ID_RAW, resp, sizeof(resp));
-                    }
-                }
-            }
+            start_job(instance, cmd, RESP_MODIFIED_KEY, 3, next_modified_key, 0, 0);
             break;
         }
             
         case CMD_SET_BRIGHTNESS:
             if (data_len >= 1) {
-                flag_brightness_set = data[0];
-                if (flag_brightness_set > 100) flag_brightness_set = 100;
+                queue_u8(instance, cmd, HID_CMD_BRIGHTNESS_SET, data[0] > 100 ? 100 : data[0]);
                 // Persist brightness across reboots.
                 flag_settings_changed = true;
             }
@@ -486,15 +920,9 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
             // Send key states response
             uint8_t resp[64] = {0};
             resp[0] = RESP_KEY_STATE;
-            // Pack key states as bits
-            for (size_t i = 0; i < key_count && i < 128; i++) {
-                if (key_states[i]) {
-                    resp[1 + (i / 8)] |= (1 << (i % 8));
-                }
-            }
-            if (tud_hid_n_ready(instance)) {
-                tud_hid_n_report(instance, REPORT_ID_RAW, resp, sizeof(resp));
-            }
+            // Key states as bits, LSB = lowest key
+            notify_get_key_bits(&resp[1]);
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
             break;
         }
             
@@ -673,34 +1101,31 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
             break;
             
         case CMD_CALIBRATE:
-            flag_calibrate = true;
+            queue_simple(instance, cmd, HID_CMD_CALIBRATE);
             break;
             
         case CMD_BOOTLOADER:
-            flag_bootloader = true;
+            queue_simple(instance, cmd, HID_CMD_BOOTLOADER);
             break;
             
         case CMD_SET_ADC_STREAM:
             // [enabled(1)]
             if (data_len >= 1) {
-                adc_stream_enabled = data[0] ? true : false;
-                flag_adc_stream_enable = true;
+                queue_u8(instance, cmd, HID_CMD_ADC_STREAM_ENABLE, data[0] ? 1 : 0);
             }
             break;
             
         case CMD_GET_KEY_ADC:
             // [key_idx] - Request ADC value for specific key
             if (data_len >= 1) {
-                get_key_adc_idx = data[0];
-                flag_get_key_adc = true;
+                queue_u8(instance, cmd, HID_CMD_GET_KEY_ADC, data[0]);
             }
             break;
 
         case CMD_SET_ADV_CAL_ENABLED:
             // [enabled(1)]
             if (data_len >= 1) {
-                adv_cal_enabled_req = data[0] ? true : false;
-                flag_set_adv_cal_enabled = true;
+                queue_u8(instance, cmd, HID_CMD_ADV_CAL_ENABLE, data[0] ? 1 : 0);
                 flag_settings_changed = true;
             }
             break;
@@ -708,10 +1133,11 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
         case CMD_SET_ADV_CAL_KEY:
             // [key_idx, release_lo, release_hi, press_lo, press_hi]
             if (data_len >= 5) {
-                adv_cal_key_idx = data[0];
-                adv_cal_release_adc = (uint16_t)(data[1] | (data[2] << 8));
-                adv_cal_press_adc = (uint16_t)(data[3] | (data[4] << 8));
-                flag_set_adv_cal_key = true;
+                hid_cmd_t c = { .type = HID_CMD_ADV_CAL_SET_KEY,
+                                .adv_cal = { .key_idx = data[0],
+                                             .release_adc = (uint16_t)(data[1] | (data[2] << 8)),
+                                             .press_adc = (uint16_t)(data[3] | (data[4] << 8)) } };
+                queue_cmd(instance, cmd, &c);
                 flag_settings_changed = true;
             }
             break;
@@ -719,8 +1145,7 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
         case CMD_GET_ADV_CAL_KEY:
             // [key_idx] -> RESP_ADV_CALIBRATION
             if (data_len >= 1) {
-                get_adv_cal_key_idx = data[0];
-                flag_get_adv_cal_key = true;
+                queue_u8(instance, cmd, HID_CMD_ADV_CAL_GET_KEY, data[0]);
             }
             break;
             
@@ -733,9 +1158,7 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
             resp[4] = lighting_get_brightness();
             lighting_get_effect_color1(&resp[5], &resp[6], &resp[7]);
             lighting_get_effect_color2(&resp[8], &resp[9], &resp[10]);
-            if (tud_hid_n_ready(instance)) {
-                tud_hid_n_report(instance, REPORT_ID_RAW, resp, sizeof(resp));
-            }
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
             break;
         }
             
@@ -763,9 +1186,7 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
                     resp[1 + i*3 + 1] = g;
                     resp[1 + i*3 + 2] = b;
                 }
-                if (tud_hid_n_ready(instance)) {
-                    tud_hid_n_report(instance, REPORT_ID_RAW, resp, sizeof(resp));
-                }
+                hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
             }
             break;
 
@@ -774,111 +1195,6 @@ void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer,
     }
 }
 
-bool hid_consume_led_power_toggle(void)
-{
-    if (flag_led_power_toggle) {
-        flag_led_power_toggle = false;
-        return true;
-    }
-    return false;
-}
-
-int hid_consume_led_power_set(void)
-{
-    int val = flag_led_power_set;
-    flag_led_power_set = -1;
-    return val;
-}
-
-bool hid_consume_socd_toggle(void)
-{
-    if (flag_socd_toggle) {
-        flag_socd_toggle = false;
-        return true;
-    }
-    return false;
-}
-
-int hid_consume_socd_set(void)
-{
-    int val = flag_socd_set;
-    flag_socd_set = -1;
-    return val;
-}
-
-int hid_consume_brightness_set(void)
-{
-    int val = flag_brightness_set;
-    flag_brightness_set = -1;
-    return val;
-}
-
-bool hid_consume_actuation_set(uint8_t *key_idx, uint8_t *threshold)
-{
-    if (flag_actuation_set) {
-        flag_actuation_set = false;
-        if (key_idx) *key_idx = actuation_key_idx;
-        if (threshold) *threshold = actuation_threshold;
-        return true;
-    }
-    return false;
-}
-
-int hid_consume_layer_set(void)
-{
-    int val = flag_layer_set;
-    flag_layer_set = -1;
-    return val;
-}
-
-bool hid_consume_keymap_set(uint8_t *layer, uint8_t *key_idx, uint8_t *keycode)
-{
-    if (flag_keymap_set) {
-        flag_keymap_set = false;
-        if (layer) *layer = keymap_layer;
-        if (key_idx) *key_idx = keymap_key_idx;
-        if (keycode) *keycode = keymap_keycode;
-        return true;
-    }
-    return false;
-}
-
-bool hid_consume_calibrate(void)
-{
-    if (flag_calibrate) {
-        flag_calibrate = false;
-        return true;
-    }
-    return false;
-}
-
-bool hid_consume_bootloader(void)
-{
-    if (flag_bootloader) {
-        flag_bootloader = false;
-        return true;
-    }
-    return false;
-}
-
-bool hid_consume_save_profile(void)
-{
-    if (flag_save_profile) {
-        flag_save_profile = false;
-        return true;
-    }
-    return false;
-}
-
-bool hid_consume_load_profile(void)
-{
-    if (flag_load_profile) {
-        flag_load_profile = false;
-        return true;
-    }
-    return false;
-}
-
 bool hid_consume_settings_changed(void)
 {
     if (flag_settings_changed) {
@@ -888,38 +1204,6 @@ bool hid_consume_settings_changed(void)
     return false;
 }
 
-bool hid_consume_profile_save(uint8_t *slot)
-{
-    if (!flag_profile_save) return false;
-    flag_profile_save = false;
-    if (slot) *slot = profile_slot;
-    return true;
-}
-
-bool hid_consume_profile_load(uint8_t *slot)
-{
-    if (!flag_profile_load) return false;
-    flag_profile_load = false;
-    if (slot) *slot = profile_slot;
-    return true;
-}
-
-bool hid_consume_profile_delete(uint8_t *slot)
-{
-    if (!flag_profile_delete) return false;
-    flag_profile_delete = false;
-    if (slot) *slot = profile_slot;
-    return true;
-}
-
-bool hid_consume_profile_blank(uint8_t *slot)
-{
-    if (!flag_profile_blank) return false;
-    flag_profile_blank = false;
-    if (slot) *slot = profile_slot;
-    return true;
-}
-
 bool hid_consume_led_update(uint8_t *buffer, size_t bufsize)
 {
     if (flag_led_update) {
@@ -935,54 +1219,18 @@ void hid_set_status_flags(uint8_t flags, uint8_t layer)
 {
     status_flags = flags;
     current_layer = layer;
+    notify_set_status(flags, layer);
 }
 
-void hid_set_key_states(const bool *states, size_t count)
-{
-    if (count > sizeof(key_states)) {
-        count = sizeof(key_states);
-    }
-    for (size_t i = 0; i < count; i++) {
-        key_states[i] = states[i];
-    }
-    key_count = count;
-}
-
-bool hid_consume_adc_stream_enable(bool *enabled) {
-    if (!flag_adc_stream_enable) return false;
-    if (enabled) *enabled = adc_stream_enabled;
-    flag_adc_stream_enable = false;
-    return true;
-}
-
-bool hid_consume_get_key_adc(uint8_t *key_idx) {
-    if (!flag_get_key_adc) return false;
-    if (key_idx) *key_idx = get_key_adc_idx;
-    flag_get_key_adc = false;
-    return true;
-}
-
-bool hid_consume_set_adv_cal_enabled(bool *enabled) {
-    if (!flag_set_adv_cal_enabled) return false;
-    if (enabled) *enabled = adv_cal_enabled_req;
-    flag_set_adv_cal_enabled = false;
-    return true;
-}
-
-bool hid_consume_set_adv_cal_key(uint8_t *key_idx, uint16_t *release_adc, uint16_t *press_adc) {
-    if (!flag_set_adv_cal_key) return false;
-    if (key_idx) *key_idx = adv_cal_key_idx;
-    if (release_adc) *release_adc = adv_cal_release_adc;
-    if (press_adc) *press_adc = adv_cal_press_adc;
-    flag_set_adv_cal_key = false;
-    return true;
-}
-
-bool hid_consume_get_adv_cal_key(uint8_t *key_idx) {
-    if (!flag_get_adv_cal_key) return false;
-    if (key_idx) *key_idx = get_adv_cal_key_idx;
-    flag_get_adv_cal_key = false;
-    return true;
+void hid_send_config_status(uint8_t instance, uint8_t cmd, uint8_t status) {
+    uint8_t resp[64] = {0};
+    resp[0] = RESP_CONFIG_STATUS;
+    resp[1] = cmd;
+    resp[2] = status;
+    const uint16_t seq = config_image_expected_seq();
+    resp[3] = (uint8_t)(seq & 0xFF);
+    resp[4] = (uint8_t)(seq >> 8);
+    hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
 }
 
 void hid_send_adv_calibration(uint8_t key_idx, bool enabled, uint16_t release_adc, uint16_t press_adc) {
@@ -996,9 +1244,7 @@ void hid_send_adv_calibration(uint8_t key_idx, bool enabled, uint16_t release_ad
     resp[6] = (press_adc >> 8) & 0xFF;
 
     // Match Shego: responses go out over Response Raw (IF3), no report ID.
-    if (tud_hid_n_ready(3)) {
-        tud_hid_n_report(3, 0, resp, sizeof(resp));
-    }
+    hid_queue_send(ITF_NUM_HID_RESP_RAW, 0, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
 }
 
 void hid_send_adc_values(const uint8_t *values, uint8_t count) {
@@ -1006,10 +1252,11 @@ void hid_send_adc_values(const uint8_t *values, uint8_t count) {
     // - Legacy single-key format:  [RESP_ADC_VALUE, key_idx, adc_lo, adc_hi, depth_mm_x10]
     // - Batched format:            [RESP_ADC_VALUE, count, {key_idx, adc_lo, adc_hi, depth}*count]
     // The app's heuristic can mis-detect a batched packet with count=1 when depth==0,
-    // so we MUST send legacy format for count==1 (same as Shego).
+    // so we MUST send legacy format for count==1 (same as Shego) - unless the
+    // host announced protocol 2+, which always parses the count.
     uint8_t resp[64] = {0};
     resp[0] = RESP_ADC_VALUE;
-    if (count == 1) {
+    if (count == 1 && host_protocol < 2) {
         // values = {key_idx, adc_lo, adc_hi, depth}
         resp[1] = values[0];
         resp[2] = values[1];
@@ -1024,7 +1271,5 @@ void hid_send_adc_values(const uint8_t *values, uint8_t count) {
     }
 
     // Match Shego: ADC responses go out over the Response Raw interface (IF3), no report ID.
-    if (tud_hid_n_ready(3)) {
-        tud_hid_n_report(3, 0, resp, sizeof(resp));
-    }
+    hid_queue_send(ITF_NUM_HID_RESP_RAW, 0, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
 }
@@ -20,6 +20,21 @@
 #define MAX_LAYERS 4
 #endif
 
+// Raw HID protocol version (CMD_GET_CAPABILITIES). Bump when a command or
+// response format changes.
+//   1: implicit, firmware without CMD_GET_CAPABILITIES
+//   2: capability query; count-prefixed RESP_ADC_VALUE on request
+#define HID_PROTOCOL_VERSION   2
+
+// Build features reported in RESP_CAPABILITIES (bitmask)
+#define HID_CAP_NKRO           0x0001
+#define HID_CAP_MIDI           0x0002
+#define HID_CAP_MOUSE          0x0004
+#define HID_CAP_RGB            0x0008
+#define HID_CAP_ENCODER        0x0010
+#define HID_CAP_DISPLAY        0x0020
+#define HID_CAP_CAPS_INDICATOR 0x0040
+
 // HID Commands (must match software main.js CMD constants)
 #define CMD_SET_LEDS           0x01  // Deprecated, use chunked
 #define CMD_SET_ALL_LEDS       0x02
@@ -75,6 +90,73 @@
 #define CMD_SET_ADV_CAL_KEY     0x62
 #define CMD_GET_ADV_CAL_KEY     0x63
 
+// USB MIDI output (MIDI_ENABLE builds; reported as unsupported otherwise)
+#define CMD_SET_MIDI_MODE       0x40  // [enabled, channel(0-15), aftertouch]
+#define CMD_GET_MIDI_MODE       0x41  // -> RESP_MIDI_MODE
+#define CMD_SET_MIDI_NOTE       0x42  // [key_idx, note] (0xFF = key is not a MIDI key)
+#define CMD_GET_MIDI_NOTES      0x43  // [offset] -> RESP_MIDI_NOTES
+
+// Two-stage keys (second, deeper actuation point per key)
+// - Set key: [key_idx, actuation_pct (0 = off), hysteresis_pct, mode (0 = add, 1 = replace)]
+// - Get key: [key_idx] -> RESP_TWO_STAGE_KEY
+// - Set keycode: [layer, key_idx, keycode]
+#define CMD_SET_TWO_STAGE_KEY     0x44
+#define CMD_GET_TWO_STAGE_KEY     0x45
+#define CMD_SET_TWO_STAGE_KEYCODE 0x46
+
+// Per-layer actuation tables (layers 1-3; layer 0 uses the base actuation)
+// - Set key: [layer, key_idx (0xFF = all keys), actuation_pct (0 = base), hysteresis_pct]
+// - Enable: [layer, enabled]
+// - Get: [layer, offset] -> RESP_LAYER_ACTUATION
+#define CMD_SET_LAYER_ACTUATION         0x47
+#define CMD_SET_LAYER_ACTUATION_ENABLED 0x48
+#define CMD_GET_LAYER_ACTUATION         0x49
+
+// HID report queue diagnostics
+#define CMD_GET_HID_QUEUE_STATS 0x4A  // -> RESP_HID_QUEUE_STATS
+
+// Full-frame ADC snapshot streaming (see adc_snapshot.h for the report layout)
+// - Set: [enabled, interval_ms, mask0, mask1, ...] (no mask bytes = all keys)
+// - Get: -> RESP_ADC_SNAPSHOT_CONFIG
+#define CMD_SET_ADC_SNAPSHOT    0x4B
+#define CMD_GET_ADC_SNAPSHOT    0x4C
+
+// Batched multi-record responses (see raw_tx.h)
+// - Set: [enabled]; Get: -> RESP_RAW_BATCHING
+#define CMD_SET_RAW_BATCHING    0x4D
+#define CMD_GET_RAW_BATCHING    0x4E
+
+// Configuration image transfer (see config_image.h)
+#define CMD_GET_CONFIG_IMAGE    0x4F  // -> RESP_CONFIG_CHUNK records + trailer
+#define CMD_CONFIG_WRITE_BEGIN  0x50  // [total u32] -> RESP_CONFIG_STATUS
+#define CMD_CONFIG_WRITE_CHUNK  0x51  // [seq u16, len, data...] (status only on error)
+#define CMD_CONFIG_WRITE_COMMIT 0x52  // [crc32 u32] -> RESP_CONFIG_STATUS (after verify and after apply)
+
+// Scan alignment to USB start-of-frame (see sof_align.h)
+// - Set: [enabled, margin_lo, margin_hi]; Get: -> RESP_SOF_ALIGN
+#define CMD_SET_SOF_ALIGN       0x53
+#define CMD_GET_SOF_ALIGN       0x54
+
+// Press-to-report latency histogram (see latency.h)
+// - [reset]: -> RESP_LATENCY_STATS, then RESP_LATENCY_HIST records
+#define CMD_GET_LATENCY         0x57
+
+// Mouse key speed curves (MOUSE_ENABLE, see mouse.h)
+// - Set: [curve, p0 u16 .. p4 u16]; Get: [curve] -> RESP_MOUSE_CURVE
+#define CMD_SET_MOUSE_CURVE     0x58
+#define CMD_GET_MOUSE_CURVE     0x59
+
+// Pushed state change events (see notify.h)
+// - [class_mask] subscribes this interface (0 = off), no data queries;
+//   -> RESP_EVENT_SUBSCRIPTION, then RESP_EVENT whenever a subscribed value changes
+#define CMD_SET_EVENTS          0x5B
+
+// Capability query: [host_version u16] (optional) -> RESP_CAPABILITIES
+// A host announcing version >= 2 gets RESP_ADC_VALUE in the count-prefixed
+// form even for a single key, until it announces a lower version or the
+// bus is reset. Hosts that never ask keep the legacy formats.
+#define CMD_GET_CAPABILITIES    0x5A
+
 // Layer and keymap commands (modern)
 #define CMD_SET_LAYER          0x23  // Set current layer (0-3)
 #define CMD_GET_LAYER          0x24  // Get current layer
@@ -143,6 +225,25 @@
 #define RESP_SIGNALRGB_ZONES  0xC6  // SignalRGB zones response [zone_mask]
 #define RESP_SOCD_PAIR        0xC7  // SOCD pair response [pair_idx, key1_idx, key2_idx, mode, valid]
 #define RESP_SOCD_MODE        0xC8  // SOCD mode response [mode, enabled]
+#define RESP_MIDI_MODE        0xC9  // MIDI mode [supported, enabled, channel, aftertouch]
+#define RESP_MIDI_NOTES       0xCA  // MIDI note map chunk [total, offset, count, notes...]
+#define RESP_TWO_STAGE_KEY    0xCB  // [key_idx, actuation_pct, hysteresis_pct, mode, kc_l0..kc_l3]
+#define RESP_LAYER_ACTUATION  0xCC  // [layer, enabled, total, offset, count, (act, hyst)*]
+#define RESP_HID_QUEUE_STATS  0xCD  // [instances, (queued u32, coalesced u32, dropped u32)*] little-endian
+#define RESP_CMD_OVERFLOW     0xCE  // Command ring full, command refused [cmd, dropped_lo, dropped_hi]
+#define RESP_ADC_SNAPSHOT     0xCF  // [seq u16, scan_us u32, part, parts, count, packed 12-bit values...]
+#define RESP_ADC_SNAPSHOT_CONFIG 0xD0 // [enabled, interval_ms, key_count, sensor_count, mask...]
+#define RESP_BATCH            0xD1  // [record_code, record_len, count, flags, records...]
+#define RESP_RAW_BATCHING     0xD2  // [enabled]
+#define RESP_CONFIG_CHUNK     0xD3  // [seq u16, len, data(60)]; seq 0xFFFF = trailer [total u32, crc32 u32]
+#define RESP_CONFIG_STATUS    0xD4  // [cmd, status, expected_seq u16]
+#define RESP_SOF_ALIGN        0xD5  // [enabled, locked, margin u16, scan_us u16, lead_avg i16, jitter u16, frames u32, missed u32, period_us u16]
+#define RESP_LATENCY_STATS    0xD6  // [samples u32, min_us u32, max_us u32, mean_us u32, overflow u32, bucket_us u16, buckets]
+#define RESP_LATENCY_HIST     0xD7  // [first_bucket, count, bucket_us u16, counts u32 * 14]
+#define RESP_MOUSE_CURVE      0xD8  // [supported, curve, p0 u16 .. p4 u16]
+#define RESP_CAPABILITIES     0xD9  // see hid_send_capabilities() in hid_reports.c
+#define RESP_EVENT_SUBSCRIPTION 0xDA // [class_mask, supported_mask]
+#define RESP_EVENT            0xDB  // [(class, len, payload...)*, 0]
 
 /**
  * @brief Handle incoming raw HID report from host
@@ -154,95 +255,12 @@
  */
 void hid_raw_receive(uint8_t instance, uint8_t report_id, uint8_t const* buffer, uint16_t len);
 
-/**
- * @brief Check if LED power toggle was requested
- * @return true if toggle requested (clears flag)
- */
-bool hid_consume_led_power_toggle(void);
-
-/**
- * @brief Get LED power set request
- * @return -1 if no request, 0 or 1 for requested state (clears flag)
- */
-int hid_consume_led_power_set(void);
-
-/**
- * @brief Check if SOCD toggle was requested
- * @return true if toggle requested (clears flag)
- */
-bool hid_consume_socd_toggle(void);
-
-/**
- * @brief Get SOCD set request
- * @return -1 if no request, 0 or 1 for requested state (clears flag)
- */
-int hid_consume_socd_set(void);
-
-/**
- * @brief Get brightness set request
- * @return -1 if no request, 0-100 for brightness percent (clears flag)
- */
-int hid_consume_brightness_set(void);
-
-/**
- * @brief Get actuation set request
- * @param key_idx Output: key index
- * @param threshold Output: threshold value
- * @return true if request pending (clears flag)
- */
-bool hid_consume_actuation_set(uint8_t *key_idx, uint8_t *threshold);
-
-/**
- * @brief Get layer set request
- * @return -1 if no request, 0-3 for layer number (clears flag)
- */
-int hid_consume_layer_set(void);
-
-/**
- * @brief Get keymap set request
- * @param layer Output: layer number
- * @param key_idx Output: key index
- * @param keycode Output: HID keycode
- * @return true if request pending (clears flag)
- */
-bool hid_consume_keymap_set(uint8_t *layer, uint8_t *key_idx, uint8_t *keycode);
-
-/**
- * @brief Check if calibration was requested
- * @return true if calibration requested (clears flag)
- */
-bool hid_consume_calibrate(void);
-
-/**
- * @brief Check if bootloader reboot was requested
- * @return true if bootloader requested (clears flag)
- */
-bool hid_consume_bootloader(void);
-
-/**
- * @brief Check if save profile was requested
- * @return true if save requested (clears flag)
- */
-bool hid_consume_save_profile(void);
-
-/**
- * @brief Check if load profile was requested
- * @return true if load requested (clears flag)
- */
-bool hid_consume_load_profile(void);
-
 /**
  * @brief Check if settings were changed and need to be saved
  * @return true if settings changed (clears flag)
  */
 bool hid_consume_settings_changed(void);
 
-// Modern profile commands (0x70+)
-bool hid_consume_profile_save(uint8_t *slot);
-bool hid_consume_profile_load(uint8_t *slot);
-bool hid_consume_profile_delete(uint8_t *slot);
-bool hid_consume_profile_blank(uint8_t *slot);
-
 /**
  * @brief Get pending LED update buffer
  * @param buffer Output buffer (must be LED_COUNT*3 bytes)
@@ -259,36 +277,25 @@ bool hid_consume_led_update(uint8_t *buffer, size_t bufsize);
 void hid_set_status_flags(uint8_t flags, uint8_t layer);
 
 /**
- * @brief Set key states for host monitoring
- * @param states Array of key states (0-indexed)
+ * @brief Send ADC values for multiple keys
+ * @param values Array of {key_idx, adc_lo, adc_hi, depth} tuples
  * @param count Number of keys
  */
-void hid_set_key_states(const bool *states, size_t count);
-
-/**
- * @brief Check if ADC streaming enable/disable was requested
- * @param enabled Output: requested enable state
- * @return true if request pending (clears flag)
- */
-bool hid_consume_adc_stream_enable(bool *enabled);
+void hid_send_adc_values(const uint8_t *values, uint8_t count);
 
 /**
- * @brief Check if ADC value request was made
- * @param key_idx Output: key index to read
- * @return true if request pending (clears flag)
+ * @brief Report the result of a configuration image command
+ * @param instance RAW interface the command arrived on
+ * @param cmd Command code being answered
+ * @param status config_status_t
  */
-bool hid_consume_get_key_adc(uint8_t *key_idx);
+void hid_send_config_status(uint8_t instance, uint8_t cmd, uint8_t status);
 
 /**
- * @brief Send ADC values for multiple keys
- * @param values Array of {key_idx, adc_lo, adc_hi, depth} tuples
- * @param count Number of keys
+ * @brief Forget the protocol version announced by the host (bus reset)
  */
-void hid_send_adc_values(const uint8_t *values, uint8_t count);
+void hid_reset_host_protocol(void);
 
-bool hid_consume_set_adv_cal_enabled(bool *enabled);
-bool hid_consume_set_adv_cal_key(uint8_t *key_idx, uint16_t *release_adc, uint16_t *press_adc);
-bool hid_consume_get_adv_cal_key(uint8_t *key_idx);
 void hid_send_adv_calibration(uint8_t key_idx, bool enabled, uint16_t release_adc, uint16_t press_adc);
 
 #endif // HID_REPORTS_H
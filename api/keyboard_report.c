@@ -0,0 +1,130 @@
+#include "keyboard_report.h"
+#include "hallscan_config.h"
+#include "usb_descriptors.h"
+#include "hid_queue.h"
+#include "latency.h"
+#include "tusb.h"
+#include <string.h>
+
+// Keyboard page usage 0x01: more keys down than the array can hold
+#define KBD_ERROR_ROLLOVER 0x01
+
+// Largest encoded report (NKRO: modifiers + bitmap)
+#define KBD_REPORT_MAX_LEN (1 + KBD_NKRO_BITMAP_BYTES)
+
+// Pressed set, maintained bit by bit from transitions - nothing dropped
+static uint8_t kbd_modifiers = 0;
+static uint8_t kbd_bits[KBD_NKRO_BITMAP_BYTES];
+static uint8_t kbd_refs[HID_KEY_GUI_RIGHT + 1];
+
+// Last report handed to TinyUSB, to suppress identical reports
+static uint8_t last_sent[KBD_REPORT_MAX_LEN];
+static uint8_t last_sent_len = 0;
+static uint8_t last_sent_id = 0xFF;
+
+static inline void set_usage_bit(uint8_t usage, bool on)
+{
+    uint8_t *byte;
+    uint8_t mask;
+    if (usage >= HID_KEY_CONTROL_LEFT) {
+        byte = &kbd_modifiers;
+        mask = (uint8_t)(1u << (usage - HID_KEY_CONTROL_LEFT));
+    } else {
+        byte = &kbd_bits[usage >> 3];
+        mask = (uint8_t)(1u << (usage & 7));
+    }
+    if (on) *byte |= mask;
+    else *byte &= (uint8_t)~mask;
+}
+
+static inline bool usage_valid(uint8_t usage)
+{
+    return usage != HID_KEY_NONE && usage <= HID_KEY_GUI_RIGHT;
+}
+
+void keyboard_report_clear(void)
+{
+    kbd_modifiers = 0;
+    memset(kbd_bits, 0, sizeof(kbd_bits));
+    memset(kbd_refs, 0, sizeof(kbd_refs));
+}
+
+void keyboard_report_press(uint8_t usage)
+{
+    if (!usage_valid(usage)) return;
+    if (kbd_refs[usage]++ == 0) set_usage_bit(usage, true);
+}
+
+void keyboard_report_release(uint8_t usage)
+{
+    if (!usage_valid(usage) || kbd_refs[usage] == 0) return;
+    if (--kbd_refs[usage] == 0) set_usage_bit(usage, false);
+}
+
+bool keyboard_report_boot_protocol(void)
+{
+    return tud_hid_n_get_protocol(ITF_NUM_HID_KBD) == HID_PROTOCOL_BOOT;
+}
+
+// Boot/6KRO form: [modifiers, reserved, key x6]. More than six keys reports
+// ErrorRollOver in every slot, as the HID spec requires for array keyboards.
+static void encode_6kro(uint8_t out[8])
+{
+    out[0] = kbd_modifiers;
+    out[1] = 0;
+    memset(&out[2], 0, 6);
+
+    uint8_t n = 0;
+    for (uint8_t byte = 0; byte < KBD_NKRO_BITMAP_BYTES; byte++) {
+        uint8_t bits = kbd_bits[byte];
+        while (bits) {
+            uint8_t bit = (uint8_t)__builtin_ctz(bits);
+            bits &= (uint8_t)(bits - 1);
+            if (n == 6) {
+                memset(&out[2], KBD_ERROR_ROLLOVER, 6);
+                return;
+            }
+            out[2 + n++] = (uint8_t)((byte << 3) | bit);
+        }
+    }
+}
+
+bool keyboard_report_send(void)
+{
+    uint8_t report[KBD_REPORT_MAX_LEN];
+    uint8_t len;
+    uint8_t report_id;
+
+    if (keyboard_report_boot_protocol()) {
+        // Boot protocol: fixed 8-byte report, no report ID
+        encode_6kro(report);
+        len = 8;
+        report_id = 0;
+    } else {
+#if NKRO_ENABLE
+        report[0] = kbd_modifiers;
+        memcpy(&report[1], kbd_bits, KBD_NKRO_BITMAP_BYTES);
+        len = 1 + KBD_NKRO_BITMAP_BYTES;
+        report_id = REPORT_ID_KBD_NKRO;
+#else
+        encode_6kro(report);
+        len = 8;
+        report_id = REPORT_ID_KBD_6KRO;
+#endif
+    }
+
+    if (report_id == last_sent_id && len == last_sent_len && memcmp(report, last_sent, len) == 0) {
+        latency_report_unchanged();
+        return true;  // host already has this state
+    }
+
+    // Only the NKRO bitmap may be coalesced; 6KRO arrays are not bitwise state
+    const uint8_t flags = (report_id == REPORT_ID_KBD_NKRO) ? HID_QUEUE_FLAG_BITMAP : HID_QUEUE_FLAG_STATE;
+    if (!hid_queue_send(ITF_NUM_HID_KBD, report_id, report, len, flags)) return false;
+    latency_report_queued(hid_queue_last_seq(ITF_NUM_HID_KBD));
+
+    memcpy(last_sent, report, len);
+    last_sent_len = len;
+    last_sent_id = report_id;
+    return true;
+}
@@ -0,0 +1,27 @@
+#ifndef KEYBOARD_REPORT_H
+#define KEYBOARD_REPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// NKRO bitmap covers keyboard page usages 0x00-0xDF; 0xE0-0xE7 are modifier bits
+#define KBD_NKRO_USAGE_COUNT   0xE0
+#define KBD_NKRO_BITMAP_BYTES  (KBD_NKRO_USAGE_COUNT / 8)
+
+// Drop every held usage (e.g. before reboot)
+void keyboard_report_clear(void);
+
+// Usage transitions (modifiers 0xE0-0xE7 map to modifier bits). Usages are
+// reference counted, so two keys bound to the same usage release correctly.
+void keyboard_report_press(uint8_t usage);
+void keyboard_report_release(uint8_t usage);
+
+// True when the host selected boot protocol on the keyboard interface
+bool keyboard_report_boot_protocol(void);
+
+// Send the current report if its encoding differs from the last one sent:
+// NKRO bitmap in report protocol (when NKRO_ENABLE), 6KRO otherwise.
+// Goes through hid_queue; returns false if the queue was full (call again).
+bool keyboard_report_send(void);
+
+#endif // KEYBOARD_REPORT_H
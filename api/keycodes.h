@@ -227,17 +227,48 @@
 #define KC_LED_TOG     0xFA   // Toggle LED power on/off
 #define KC_SOCD_TOG    0xFB   // Toggle SOCD on/off
 
+// ============================================================================
+// MOUSE KEYS (sent via Mouse report, MOUSE_ENABLE)
+// ============================================================================
+// Move and wheel speed follow key depth (see features/mouse/mouse.h)
+#define KC_MS_U   0xF0   // Cursor up
+#define KC_MS_D   0xF1   // Cursor down
+#define KC_MS_L   0xF2   // Cursor left
+#define KC_MS_R   0xF3   // Cursor right
+#define KC_WH_U   0xF4   // Wheel up
+#define KC_WH_D   0xF5   // Wheel down
+#define KC_WH_L   0xF6   // Wheel left (pan)
+#define KC_WH_R   0xF7   // Wheel right (pan)
+#define KC_BTN1   0xED   // Left button
+#define KC_BTN2   0xEE   // Right button
+#define KC_BTN3   0xEF   // Middle button
+#define KC_BTN4   0xFC   // Back
+#define KC_BTN5   0xFD   // Forward
+
 // ============================================================================
 // CONSUMER / MEDIA KEYS (sent via Consumer Control report)
 // ============================================================================
-// These use the 0xE0-0xE7 range (processed specially in HID report building)
-#define KC_MUTE   0xE0   // Mute
-#define KC_VOLD   0xE1   // Volume down
-#define KC_VOLU   0xE2   // Volume up
-#define KC_MNXT   0xE3   // Next track
-#define KC_MPRV   0xE4   // Previous track
-#define KC_MSTP   0xE5   // Stop
-#define KC_MPLY   0xE6   // Play/Pause
-#define KC_EJCT   0xE7   // Eject
+// Codes the host app already uses for media keys; main.c maps them to
+// consumer usages. (0xE0-0xE7 are the modifiers and cannot be used here.)
+// Keys added later sit in 0xE8-0xEB, which no keyboard usage occupies.
+#define KC_MUTE   0x7F   // Mute
+#define KC_VOLU   0x80   // Volume up
+#define KC_VOLD   0x81   // Volume down
+#define KC_MNXT   0xB5   // Next track
+#define KC_MPRV   0xB6   // Previous track
+#define KC_MPLY   0xCD   // Play/Pause
+#define KC_MFFD   0xE8   // Fast forward
+#define KC_MRWD   0xE9   // Rewind
+#define KC_MSTP   0xEA   // Stop
+#define KC_EJCT   0xEB   // Eject
+#define KC_BRIU   0x6F   // Screen brightness up (shares KC_F20's code)
+#define KC_BRID   0x70   // Screen brightness down (shares KC_F21's code)
+
+// ============================================================================
+// SYSTEM CONTROL KEYS (sent via System Control report)
+// ============================================================================
+#define KC_PWR    0xA5   // System power down
+#define KC_SLEP   0xA6   // System sleep
+#define KC_WAKE   0xA7   // System wake up
 
 #endif // MARSVLT_KEYCODES_H
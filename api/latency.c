@@ -0,0 +1,152 @@
+#include "latency.h"
+#include "hid_queue.h"
+#include "hid_reports.h"
+#include "usb_descriptors.h"
+#include "pico/time.h"
+#include <string.h>
+
+// Everything here runs in main loop context (scan, keyboard_report_send and
+// tud_hid_report_complete_cb via tud_task), so no locking is needed.
+
+typedef struct {
+    uint32_t sample_us;
+    uint32_t seq;       // hid_queue sequence of the carrying report (once stamped)
+} latency_mark_t;
+
+typedef struct {
+    uint32_t buckets[LATENCY_BUCKETS];
+    uint32_t samples;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t overflow;
+} latency_hist_t;
+
+// FIFO of transitions: the first 'stamped' entries belong to a queued report
+static latency_mark_t marks[LATENCY_PENDING];
+static uint8_t marks_head = 0;
+static uint8_t marks_count = 0;
+static uint8_t marks_stamped = 0;
+
+static latency_hist_t live;
+static latency_hist_t snap;
+
+static inline latency_mark_t *mark_at(uint8_t pos)
+{
+    return &marks[(marks_head + pos) % LATENCY_PENDING];
+}
+
+static void hist_clear(latency_hist_t *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->min_us = UINT32_MAX;
+}
+
+static void hist_add(latency_hist_t *h, uint32_t us)
+{
+    uint32_t b = us / LATENCY_BUCKET_US;
+    if (b >= LATENCY_BUCKETS) b = LATENCY_BUCKETS - 1;
+    h->buckets[b]++;
+    h->samples++;
+    h->sum_us += us;
+    if (us < h->min_us) h->min_us = us;
+    if (us > h->max_us) h->max_us = us;
+}
+
+// hid_queue: a keyboard report was delivered. It carries every send up to
+// seq, so all marks stamped with an older or equal sequence are done.
+static void report_complete(uint8_t instance, uint32_t seq)
+{
+    (void)instance;
+    const uint32_t now = time_us_32();
+    while (marks_stamped > 0) {
+        const latency_mark_t *m = mark_at(0);
+        if ((int32_t)(m->seq - seq) > 0) break;
+        hist_add(&live, now - m->sample_us);
+        marks_head = (uint8_t)((marks_head + 1) % LATENCY_PENDING);
+        marks_count--;
+        marks_stamped--;
+    }
+}
+
+void latency_init(void)
+{
+    marks_head = 0;
+    marks_count = 0;
+    marks_stamped = 0;
+    hist_clear(&live);
+    hist_clear(&snap);
+    hid_queue_set_complete_handler(ITF_NUM_HID_KBD, report_complete);
+}
+
+void latency_mark(uint32_t sample_us)
+{
+    if (marks_count >= LATENCY_PENDING) {
+        live.overflow++;
+        return;
+    }
+    latency_mark_t *m = mark_at(marks_count);
+    m->sample_us = sample_us;
+    m->seq = 0;
+    marks_count++;
+}
+
+void latency_report_queued(uint32_t seq)
+{
+    while (marks_stamped < marks_count) {
+        mark_at(marks_stamped)->seq = seq;
+        marks_stamped++;
+    }
+}
+
+void latency_report_unchanged(void)
+{
+    // Unstamped marks sit at the tail
+    marks_count = marks_stamped;
+}
+
+void latency_snapshot(bool reset)
+{
+    snap = live;
+    if (reset) hist_clear(&live);
+}
+
+void latency_get_stats(latency_stats_t *out)
+{
+    if (!out) return;
+    out->samples = snap.samples;
+    out->min_us = snap.samples ? snap.min_us : 0;
+    out->max_us = snap.max_us;
+    out->mean_us = snap.samples ? (uint32_t)(snap.sum_us / snap.samples) : 0;
+    out->overflow = snap.overflow;
+}
+
+// RESP_LATENCY_HIST record, cursor = first bucket
+static bool next_hist_record(raw_tx_job_t *job, uint8_t *rec)
+{
+    if (job->cursor >= LATENCY_BUCKETS) return false;
+    uint8_t n = LATENCY_BUCKETS - job->cursor;
+    if (n > LATENCY_HIST_PER_RECORD) n = LATENCY_HIST_PER_RECORD;
+
+    rec[0] = (uint8_t)job->cursor;
+    rec[1] = n;
+    rec[2] = (uint8_t)(LATENCY_BUCKET_US & 0xFF);
+    rec[3] = (uint8_t)(LATENCY_BUCKET_US >> 8);
+    for (uint8_t i = 0; i < n; i++) {
+        const uint32_t c = snap.buckets[job->cursor + i];
+        rec[4 + i * 4] = (uint8_t)(c & 0xFF);
+        rec[5 + i * 4] = (uint8_t)((c >> 8) & 0xFF);
+        rec[6 + i * 4] = (uint8_t)((c >> 16) & 0xFF);
+        rec[7 + i * 4] = (uint8_t)((c >> 24) & 0xFF);
+    }
+    job->cursor = (uint16_t)(job->cursor + n);
+    return true;
+}
+
+void latency_hist_job(raw_tx_job_t *job)
+{
+    memset(job, 0, sizeof(*job));
+    job->resp_code = RESP_LATENCY_HIST;
+    job->record_len = 4 + LATENCY_HIST_PER_RECORD * 4;
+    job->next = next_hist_record;
+}
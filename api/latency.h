@@ -0,0 +1,48 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "raw_tx.h"
+
+// Press-to-report latency, measured on the keyboard interface. Each key
+// transition is stamped with the time its sensor was sampled; the stamp is
+// tied to the keyboard report that first carries the change and closed when
+// TinyUSB reports that report delivered (tud_hid_report_complete_cb, main
+// loop context). Transitions that change no keyboard report (layer keys,
+// consumer keys, SOCD-suppressed keys) are not counted.
+//
+// Histogram: LATENCY_BUCKETS buckets of LATENCY_BUCKET_US; the last bucket
+// also holds everything longer.
+
+#define LATENCY_BUCKETS        64
+#define LATENCY_BUCKET_US      100
+#define LATENCY_PENDING        32      // transitions awaiting delivery
+#define LATENCY_HIST_PER_RECORD 14
+
+typedef struct {
+    uint32_t samples;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t mean_us;
+    uint32_t overflow;    // transitions not measured: pending list was full
+} latency_stats_t;
+
+void latency_init(void);    // after hid_queue_init()
+
+// Key transition sampled at sample_us (scan)
+void latency_mark(uint32_t sample_us);
+
+// Keyboard report bookkeeping (keyboard_report_send)
+void latency_report_queued(uint32_t seq);   // marks ride on the report with this hid_queue sequence
+void latency_report_unchanged(void);        // marks changed nothing the host sees
+
+// Freeze the histogram for reading; reset starts a new measurement
+void latency_snapshot(bool reset);
+void latency_get_stats(latency_stats_t *out);   // of the snapshot
+
+// raw_tx job streaming the snapshot histogram as RESP_LATENCY_HIST records
+// [first_bucket, count, bucket_us u16, counts u32 * LATENCY_HIST_PER_RECORD]
+void latency_hist_job(raw_tx_job_t *job);
+
+#endif // LATENCY_H
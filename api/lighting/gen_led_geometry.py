@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+"""Generate the per-key LED geometry table from a board's KLE layout.json.
+
+Usage: gen_led_geometry.py <layout.json> <output.h>
+
+Keys are taken in layout order, which must match the logical key LED order
+(the sensor enum / led_position_map order in config.h). For each key the
+centre is normalized to 0..1 over the board, and its distance from the
+board centre is stored too (scaled by sqrt(2) so the corners reach ~1.0,
+like the radial effect expects). Values are Q16 in uint16_t, with 0xFFFF
+standing for 1.0.
+"""
+
+import json
+import math
+import sys
+
+
+def kle_key_centres(rows):
+    """Key centres (x, y) in key units, following KLE positioning rules."""
+    centres = []
+    y = 0.0
+    for row in rows:
+        if not isinstance(row, list):
+            continue  # keyboard metadata object
+        x = 0.0
+        w = h = 1.0
+        for item in row:
+            if isinstance(item, dict):
+                x += item.get("x", 0.0)
+                y += item.get("y", 0.0)
+                w = item.get("w", w)
+                h = item.get("h", h)
+                continue
+            centres.append((x + w / 2.0, y + h / 2.0))
+            x += w
+            w = h = 1.0
+        y += 1.0
+    return centres
+
+
+def q16(v):
+    v = min(max(v, 0.0), 1.0)
+    return 0xFFFF if v >= 1.0 else int(round(v * 65536.0))
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: gen_led_geometry.py <layout.json> <output.h>")
+
+    with open(sys.argv[1], encoding="utf-8") as f:
+        centres = kle_key_centres(json.load(f))
+    if not centres:
+        sys.exit("gen_led_geometry.py: no keys in " + sys.argv[1])
+
+    xs = [c[0] for c in centres]
+    ys = [c[1] for c in centres]
+    x0, x1 = min(xs), max(xs)
+    y0, y1 = min(ys), max(ys)
+
+    lines = [
+        "// Generated by gen_led_geometry.py from layout.json - do not edit",
+        "#ifndef LED_GEOMETRY_H",
+        "#define LED_GEOMETRY_H",
+        "",
+        "#define LED_GEOMETRY_KEY_COUNT %d" % len(centres),
+        "",
+        "// {x, y, radial} per key in layout order",
+        "static const led_geometry_t led_layout_geometry[LED_GEOMETRY_KEY_COUNT] = {",
+    ]
+    for cx, cy in centres:
+        nx = 0.5 if x1 == x0 else (cx - x0) / (x1 - x0)
+        ny = 0.5 if y1 == y0 else (cy - y0) / (y1 - y0)
+        radial = math.hypot(nx - 0.5, ny - 0.5) * 1.414
+        lines.append("    { %5d, %5d, %5d }," % (q16(nx), q16(ny), q16(radial)))
+    lines += ["};", "", "#endif // LED_GEOMETRY_H", ""]
+
+    with open(sys.argv[2], "w", encoding="utf-8", newline="\n") as f:
+        f.write("\n".join(lines))
+
+
+if __name__ == "__main__":
+    main()
@@ -2,18 +2,98 @@
 #include "hallscan_config.h"
 #include <stdio.h>
 #include <string.h>
-#include <math.h>
 #include "pico/stdlib.h"
 #include "hardware/pio.h"
 #include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
 
 // include PIO program header generated by pico SDK for ws2812
 #include "ws2812.pio.h"
 
 static PIO pio = pio0;
 static uint sm = 0;
-// brightness scale in range [0.0 .. 1.0]
-static float g_brightness_scale = 1.0f;
+
+// WS2812 output: each frame is encoded into GRB words and a DMA channel
+// feeds them to the PIO TX FIFO. The next frame is encoded into the other
+// buffer while one shifts out, so lighting costs render time, not wire time.
+#define WS2812_LED_US    30u    // 24 bits at 800 kHz
+#define WS2812_RESET_US  300u   // line low between frames (newer parts latch after 280 us)
+
+static uint ws2812_dma = 0;
+static uint32_t frame_words[2][LED_COUNT];
+static uint8_t frame_render = 0;    // buffer the next frame is encoded into
+static bool frame_pending = false;  // frame_words[frame_render] waits for the line
+static uint32_t wire_free_us = 0;   // previous frame shifted out and latched by then
+
+// Threading: after lighting_start() core1 renders frames at LIGHTING_FPS, so
+// rendering and LED output never land on a scan. The setters run on core0
+// and write effect inputs in place, then bump input_seq; core1 renders again
+// when it differs from the sequence of its last frame (a frame caught in the
+// middle of an update is redrawn by the next). State that animates by itself
+// (phase, reactive fades, SOCD animation) belongs to core1; core0 hands it
+// events through counters only core0 increments.
+static volatile uint32_t input_seq = 1;
+static volatile bool output_enabled = false;
+static bool core1_running = false;
+
+// Core1's own stack. The default one (.stack1 in SCRATCH_X) sits right below
+// core0's 4 KB stack in SCRATCH_Y, where a deep core0 call would run into it.
+#define LIGHTING_CORE1_STACK_WORDS 1024
+static uint32_t core1_stack[LIGHTING_CORE1_STACK_WORDS];
+
+// Fixed point: positions and gradient coordinates are Q16 (Q16_ONE = 1.0).
+// The RP2040 has no FPU, so nothing per pixel uses float or libm.
+#define Q16_ONE  65536
+#define Q16_HALF 32768
+
+// sin(0..90 degrees) in Q15
+static const uint16_t sine_q15[91] = {
+        0,   572,  1144,  1715,  2286,  2856,  3425,  3993,  4560,  5126,
+     5690,  6252,  6813,  7371,  7927,  8481,  9032,  9580, 10126, 10668,
+    11207, 11743, 12275, 12803, 13328, 13848, 14365, 14876, 15384, 15886,
+    16384, 16877, 17364, 17847, 18324, 18795, 19261, 19720, 20174, 20622,
+    21063, 21498, 21926, 22348, 22763, 23170, 23571, 23965, 24351, 24730,
+    25102, 25466, 25822, 26170, 26510, 26842, 27166, 27482, 27789, 28088,
+    28378, 28660, 28932, 29197, 29452, 29698, 29935, 30163, 30382, 30592,
+    30792, 30983, 31164, 31336, 31499, 31651, 31795, 31928, 32052, 32166,
+    32270, 32365, 32449, 32524, 32588, 32643, 32688, 32723, 32748, 32763,
+    32768,
+};
+
+#if LED_GAMMA_CORRECTION
+// (i / 255)^2.2 in 0..65535: perceptual gamma for the output table
+static const uint16_t gamma22_u16[256] = {
+        0,     0,     2,     4,     7,    11,    17,    24,    32,    42,    53,    65,
+       79,    94,   111,   129,   148,   169,   192,   216,   242,   270,   299,   330,
+      362,   396,   432,   469,   508,   549,   591,   635,   681,   729,   779,   830,
+      883,   938,   995,  1053,  1113,  1175,  1239,  1305,  1373,  1443,  1514,  1587,
+     1663,  1740,  1819,  1900,  1983,  2068,  2155,  2243,  2334,  2427,  2521,  2618,
+     2717,  2817,  2920,  3024,  3131,  3240,  3350,  3463,  3578,  3694,  3813,  3934,
+     4057,  4182,  4309,  4438,  4570,  4703,  4838,  4976,  5115,  5257,  5401,  5547,
+     5695,  5845,  5998,  6152,  6309,  6468,  6629,  6792,  6957,  7124,  7294,  7466,
+     7640,  7816,  7994,  8175,  8358,  8543,  8730,  8919,  9111,  9305,  9501,  9699,
+     9900, 10102, 10307, 10515, 10724, 10936, 11150, 11366, 11585, 11806, 12029, 12254,
+    12482, 12712, 12944, 13179, 13416, 13655, 13896, 14140, 14386, 14635, 14885, 15138,
+    15394, 15652, 15912, 16174, 16439, 16706, 16975, 17247, 17521, 17798, 18077, 18358,
+    18642, 18928, 19216, 19507, 19800, 20095, 20393, 20694, 20996, 21301, 21609, 21919,
+    22231, 22546, 22863, 23182, 23504, 23829, 24156, 24485, 24817, 25151, 25487, 25826,
+    26168, 26512, 26858, 27207, 27558, 27912, 28268, 28627, 28988, 29351, 29717, 30086,
+    30457, 30830, 31206, 31585, 31966, 32349, 32735, 33124, 33514, 33908, 34304, 34702,
+    35103, 35507, 35913, 36321, 36732, 37146, 37562, 37981, 38402, 38825, 39252, 39680,
+    40112, 40546, 40982, 41421, 41862, 42306, 42753, 43202, 43654, 44108, 44565, 45025,
+    45487, 45951, 46418, 46888, 47360, 47835, 48313, 48793, 49275, 49761, 50249, 50739,
+    51232, 51728, 52226, 52727, 53230, 53736, 54245, 54756, 55270, 55787, 56306, 56828,
+    57352, 57879, 58409, 58941, 59476, 60014, 60554, 61097, 61642, 62190, 62741, 63295,
+    63851, 64410, 64971, 65535,
+};
+#endif
+
+// Brightness as set, and the output table encode_pixel() reads: gamma and
+// the brightness cap folded together, rebuilt when the brightness changes
+static uint8_t g_brightness_percent = 100;
+static uint8_t output_lut[256];
 
 // Effect state
 static led_effect_t current_effect = LED_EFFECT_STATIC;
@@ -22,7 +102,10 @@ static uint8_t effect_direction = 0;
 static uint8_t color1_r = 255, color1_g = 0, color1_b = 0;
 static uint8_t color2_r = 0, color2_g = 0, color2_b = 255;
 static uint32_t effect_phase = 0;
+static uint32_t phase_acc_ms = 0;     // time toward the next phase step
 static uint32_t last_update_ms = 0;
+static volatile uint8_t effect_restart_req = 0;  // core0: lighting_set_effect()
+static uint8_t effect_restart_seen = 0;
 
 // LED buffer - stores colors at PHYSICAL strip indices (like Shego)
 static uint8_t led_buffer[LED_COUNT * 3];
@@ -38,6 +121,28 @@ static uint8_t gradient_colors[8 * 3];
 static uint8_t gradient_num_colors = 2;
 static uint8_t gradient_orientation = 0;  // 0=horizontal, 1=vertical, 2=diag TL-BR, 3=diag TR-BL
 static uint16_t gradient_rotation_deg = 0;
+static int32_t gradient_rot_cos = 32768;  // Q15, follows gradient_rotation_deg
+static int32_t gradient_rot_sin = 0;
+
+// Per-key geometry, Q16 with 0xFFFF standing for 1.0
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint16_t radial;   // distance from the board centre * 1.414 (~0..1)
+} led_geometry_t;
+
+// Built from the board's layout.json by gen_led_geometry.py (build.cmake)
+#ifdef LED_GEOMETRY_GENERATED
+#include "led_geometry.h"
+#if LED_GEOMETRY_KEY_COUNT != KEY_LED_COUNT
+#warning "layout.json key count differs from KEY_LED_COUNT; extra keys share the last key's position"
+#endif
+#endif
+
+// Filled once by lighting_init(); effects only look positions up
+static led_geometry_t key_geometry[KEY_LED_COUNT];
+// gradient_base_t() of every key, follows the gradient parameters
+static int32_t key_gradient_pos[KEY_LED_COUNT];
 
 // Static LED buffer - stores host-sent per-LED colors for Static mode
 static uint8_t static_led_buffer[LED_COUNT * 3];
@@ -46,9 +151,10 @@ static uint8_t static_led_buffer[LED_COUNT * 3];
 // Non-black values here override any effect including Static
 static uint8_t paint_overlay_buffer[LED_COUNT * 3];
 
-// Reactive keypress tracking
+// Reactive keypress tracking: presses counted on core0, fades on core1
 static uint8_t reactive_keys[SENSOR_COUNT];
-static uint32_t reactive_decay = 0;
+static volatile uint8_t key_press_count[SENSOR_COUNT];
+static uint8_t key_press_seen[SENSOR_COUNT];
 
 // Layer indicator state
 static uint8_t layer_colors[4][3] = {
@@ -57,8 +163,7 @@ static uint8_t layer_colors[4][3] = {
     {174, 0, 255},    // Layer 2 - default purple
     {255, 175, 0}     // Layer 3 - default amber
 };
-static uint8_t current_layer_for_indicator = 0;
-static bool layer_indicator_forced = false;
+static volatile uint8_t current_layer_for_indicator = 0;
 
 // Caps lock indicator state
 static bool caps_overlay_enabled = false;
@@ -71,19 +176,84 @@ static bool socd_anim_green = true;    // true = enable (green), false = disable
 static uint8_t socd_anim_step = 0;     // 0..AMBIENT_LED_COUNT/2 (center-out steps)
 static uint32_t socd_anim_last_ms = 0;
 static uint8_t socd_anim_fade = 255;   // fade-out counter (255..0)
+static volatile bool socd_anim_req_green = true; // core0: lighting_socd_animation()
+
+// Frame skipping: a frame is rendered and sent only when an input changed,
+// the effect animates, or the periodic refresh is due. Unchanged static
+// lighting costs nothing.
+static uint32_t rendered_seq = 0;
+static uint32_t last_frame_ms = 0;
+
+// Setters: publish the write to core1
+static inline void inputs_changed(void) {
+    __dmb();
+    input_seq++;
+}
+
+// Overlay stack, bottom to top (see the compositor below)
+typedef enum {
+    OVERLAY_SIGNALRGB = 0,
+    OVERLAY_PAINT,
+    OVERLAY_LAYER,
+    OVERLAY_CAPS,
+    OVERLAY_SOCD,
+    OVERLAY_COUNT
+} overlay_id_t;
+
+static void overlay_changed(overlay_id_t id);
+
+static void output_lut_rebuild(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+#if LED_GAMMA_CORRECTION
+        // Rounded: gamma22_u16[i] * 255 * percent / (65535 * 100)
+        output_lut[i] = (uint8_t)((gamma22_u16[i] * 255u * g_brightness_percent + 3276750u) / 6553500u);
+#else
+        output_lut[i] = (uint8_t)((i * g_brightness_percent) / 100u);
+#endif
+    }
+}
 
-// helper to write a 24-bit GRB pixel into PIO FIFO (pio program expects 24-bit data left-aligned)
-static inline void ws2812_put_pixel(PIO pio_inst, uint sm_idx, uint32_t grb) {
-    pio_sm_put_blocking(pio_inst, sm_idx, grb << 8u);
+// Apply gamma and brightness and encode a pixel as a PIO FIFO word (24-bit GRB, left-aligned)
+static inline uint32_t encode_pixel(uint8_t r, uint8_t g, uint8_t b) {
+    uint32_t grb = ((uint32_t)output_lut[g] << 16) | ((uint32_t)output_lut[r] << 8) | (uint32_t)output_lut[b];
+    return grb << 8u;
 }
 
-// Apply brightness and send pixel
-static inline void send_pixel(uint8_t r, uint8_t g, uint8_t b) {
-    uint8_t r2 = (uint8_t)((float)r * g_brightness_scale);
-    uint8_t g2 = (uint8_t)((float)g * g_brightness_scale);
-    uint8_t b2 = (uint8_t)((float)b * g_brightness_scale);
-    uint32_t grb = ((uint32_t)g2 << 16) | ((uint32_t)r2 << 8) | (uint32_t)b2;
-    ws2812_put_pixel(pio, sm, grb);
+// True when a phase step changes the frame with no input changed
+static bool frame_animated(void) {
+    switch (current_effect) {
+        case LED_EFFECT_STATIC:
+        case LED_EFFECT_GRADIENT:
+            return false;
+        case LED_EFFECT_REACTIVE:
+            for (int i = 0; i < SENSOR_COUNT; i++) {
+                if (reactive_keys[i] > 0) return true;
+            }
+            return false;
+        default:
+            return true;
+    }
+}
+
+// Start the encoded frame once the previous one is out and latched. A frame
+// that has to wait is started from the next lighting_update() call, and a
+// newer frame encoded meanwhile replaces it.
+static void ws2812_kick(void) {
+    if (!frame_pending) return;
+    if (dma_channel_is_busy(ws2812_dma) || (int32_t)(time_us_32() - wire_free_us) < 0) return;
+    dma_channel_transfer_from_buffer_now(ws2812_dma, frame_words[frame_render], LED_COUNT);
+    wire_free_us = time_us_32() + LED_COUNT * WS2812_LED_US + WS2812_RESET_US;
+    frame_render ^= 1u;
+    frame_pending = false;
+}
+
+// Queue an all-black frame in place of any pending one; true once it is on
+// the wire. Black encodes to zero words whatever the brightness.
+static bool ws2812_blank(void) {
+    memset(frame_words[frame_render], 0, sizeof(frame_words[0]));
+    frame_pending = true;
+    ws2812_kick();
+    return !frame_pending;
 }
 
 // ========================================
@@ -115,15 +285,57 @@ static inline void set_ambient_idx_rgb(int idx, uint8_t r, uint8_t g, uint8_t b)
 #endif
 }
 
-// Clamp float to 0..1 range
-static inline float clamp01f(float x) {
-    if (x < 0.0f) return 0.0f;
-    if (x > 1.0f) return 1.0f;
+// Clamp Q16 to 0..1 range
+static inline int32_t clamp01_q16(int32_t x) {
+    if (x < 0) return 0;
+    if (x > Q16_ONE) return Q16_ONE;
     return x;
 }
 
-// Get X,Y position for a logical key index (for 2D effects like radial/gradient)
-static void mina_taki_logical_xy(int logical, float *x_out, float *y_out) {
+// sin of a whole number of degrees, Q15
+static int32_t sin_deg_q15(int32_t deg) {
+    deg %= 360;
+    if (deg < 0) deg += 360;
+    if (deg <= 90) return sine_q15[deg];
+    if (deg <= 180) return sine_q15[180 - deg];
+    if (deg <= 270) return -(int32_t)sine_q15[deg - 180];
+    return -(int32_t)sine_q15[360 - deg];
+}
+
+// Q16 position of entry i on a strip of n LEDs (0..1, centre if n <= 1)
+static inline int32_t strip_pos_q16(int i, int n) {
+    return (n <= 1) ? Q16_HALF : (int32_t)((i * Q16_ONE) / (n - 1));
+}
+
+static inline int32_t geom_q16(uint16_t v) {
+    return (v == 0xFFFF) ? Q16_ONE : (int32_t)v;
+}
+
+#ifndef LED_GEOMETRY_GENERATED
+static inline uint16_t geom_u16(int32_t v) {
+    return (v >= Q16_ONE) ? 0xFFFF : (uint16_t)clamp01_q16(v);
+}
+
+// Integer square root (floor)
+static uint32_t isqrt32(uint32_t v) {
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > v) bit >>= 2;
+    while (bit != 0) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+// Fallback for boards without layout.json: X,Y position (Q16) for a logical
+// key index from the Mina/Taki row table
+static void mina_taki_logical_xy(int logical, int32_t *x_out, int32_t *y_out) {
     // Mina/Taki key rows: 14, 15, 14, 14, 9/11 (Mina has 66, Taki has 68)
     static const int row_lens[5] = {14, 15, 14, 14, KEY_LED_COUNT - 57};  // Last row varies
     const int rows = 5;
@@ -149,144 +361,319 @@ static void mina_taki_logical_xy(int logical, float *x_out, float *y_out) {
         idx = (row_lens[row] - 1) - idx;
     }
 
-    float x = (row_lens[row] <= 1) ? 0.5f : ((float)idx / (float)(row_lens[row] - 1));
-    float y = (rows <= 1) ? 0.5f : ((float)row / (float)(rows - 1));
-    
-    *x_out = clamp01f(x);
-    *y_out = clamp01f(y);
+    *x_out = clamp01_q16(strip_pos_q16(idx, row_lens[row]));
+    *y_out = clamp01_q16(strip_pos_q16(row, rows));
+}
+#endif // !LED_GEOMETRY_GENERATED
+
+static void key_geometry_init(void) {
+    for (int i = 0; i < KEY_LED_COUNT; i++) {
+#ifdef LED_GEOMETRY_GENERATED
+        const int src = (i < LED_GEOMETRY_KEY_COUNT) ? i : LED_GEOMETRY_KEY_COUNT - 1;
+        key_geometry[i] = led_layout_geometry[src];
+#else
+        int32_t x, y;
+        mina_taki_logical_xy(i, &x, &y);
+        int32_t dx = x - Q16_HALF;
+        int32_t dy = y - Q16_HALF;
+        // dx^2 + dy^2 <= 2^31 (Q32), its root is Q16; * 1.414 (Q15) normalizes to ~0..1
+        uint32_t dist = isqrt32((uint32_t)(dx * dx) + (uint32_t)(dy * dy));
+        key_geometry[i].x = geom_u16(x);
+        key_geometry[i].y = geom_u16(y);
+        key_geometry[i].radial = geom_u16((int32_t)((dist * 46334u) >> 15));
+#endif
+    }
 }
 
-// Calculate gradient position based on orientation and rotation (like Shego)
-static float gradient_base_t(float x, float y) {
-    // If rotation is set, use rotated projection
+// Calculate gradient position (Q16) based on orientation and rotation (like Shego)
+static int32_t gradient_base_t(int32_t x, int32_t y) {
+    // If rotation is set, use rotated projection (|rot_x| <= 0.71, no overflow)
     if (gradient_rotation_deg != 0) {
-        float rot = ((float)gradient_rotation_deg * 3.14159265f) / 180.0f;
-        float cx = x - 0.5f;
-        float cy = y - 0.5f;
-        float rot_x = cx * cosf(rot) - cy * sinf(rot);
-        return clamp01f(rot_x + 0.5f);
+        int32_t cx = x - Q16_HALF;
+        int32_t cy = y - Q16_HALF;
+        int32_t rot_x = (cx * gradient_rot_cos - cy * gradient_rot_sin) >> 15;
+        return clamp01_q16(rot_x + Q16_HALF);
     }
 
     // Otherwise use discrete orientation
     switch (gradient_orientation) {
-        case 0: return clamp01f(x);                    // Horizontal (L->R)
-        case 1: return clamp01f(y);                    // Vertical (T->B)
-        case 2: return clamp01f((x + y) * 0.5f);       // Diagonal TL->BR
-        case 3: return clamp01f((y + (1.0f - x)) * 0.5f); // Diagonal TR->BL
-        default: return clamp01f(x);                   // Default horizontal
+        case 0: return clamp01_q16(x);                       // Horizontal (L->R)
+        case 1: return clamp01_q16(y);                       // Vertical (T->B)
+        case 2: return clamp01_q16((x + y) >> 1);            // Diagonal TL->BR
+        case 3: return clamp01_q16((y + (Q16_ONE - x)) >> 1); // Diagonal TR->BL
+        default: return clamp01_q16(x);                      // Default horizontal
+    }
+}
+
+static void key_gradient_update(void) {
+    for (int i = 0; i < KEY_LED_COUNT; i++) {
+        key_gradient_pos[i] = gradient_base_t(geom_q16(key_geometry[i].x), geom_q16(key_geometry[i].y));
     }
 }
 
-// Output all LEDs to the WS2812 strip (in physical order)
-static void output_leds(void) {
-    // Apply paint overlay - any non-black LED in paint_overlay_buffer overrides the effect
-    // This allows paint mode to work on top of any effect, persisting across effect changes
-    // We read from logical positions and apply to physical positions
+// ========================================
+// Overlay compositor
+// ========================================
+// Overlays stack on the rendered effect in table order. Each keeps its own
+// pixels and a coverage mask over physical LEDs: compositing touches only
+// covered pixels, and an overlay is re-evaluated only when its inputs
+// changed (setters bump req on core0, core1 compares with seen) or, while
+// it animates, every frame.
+
+typedef enum {
+    BLEND_REPLACE = 0,
+    BLEND_ADD,      // saturating
+    BLEND_ALPHA,    // alpha over what is below
+} blend_mode_t;
+
+#define COVER_WORDS ((LED_COUNT + 31) / 32)
+
+typedef struct overlay overlay_t;
+
+// Fill o (cover is cleared beforehand); changed = inputs changed since the
+// last call. Returns true to be called again next frame.
+typedef bool (*overlay_eval_fn)(overlay_t *o, bool changed, uint32_t now_ms);
+
+struct overlay {
+    overlay_eval_fn eval;
+    uint8_t blend;
+    uint8_t alpha;                 // BLEND_ALPHA: 255 = opaque
+    volatile uint8_t req;          // core0: inputs changed
+    uint8_t seen;                  // core1: req at the last evaluation
+    bool animating;
+    uint32_t cover[COVER_WORDS];   // physical LEDs this overlay sets
+    uint8_t rgb[LED_COUNT * 3];    // physical order, valid where covered
+};
+
+static bool overlay_eval_signalrgb(overlay_t *o, bool changed, uint32_t now_ms);
+static bool overlay_eval_paint(overlay_t *o, bool changed, uint32_t now_ms);
+static bool overlay_eval_layer(overlay_t *o, bool changed, uint32_t now_ms);
+static bool overlay_eval_caps(overlay_t *o, bool changed, uint32_t now_ms);
+static bool overlay_eval_socd(overlay_t *o, bool changed, uint32_t now_ms);
+
+// Bottom to top
+static overlay_t overlays[OVERLAY_COUNT] = {
+    [OVERLAY_SIGNALRGB] = { .eval = overlay_eval_signalrgb, .blend = BLEND_REPLACE, .alpha = 255 },
+    [OVERLAY_PAINT]     = { .eval = overlay_eval_paint,     .blend = BLEND_REPLACE, .alpha = 255 },
+    [OVERLAY_LAYER]     = { .eval = overlay_eval_layer,     .blend = BLEND_REPLACE, .alpha = 255 },
+    [OVERLAY_CAPS]      = { .eval = overlay_eval_caps,      .blend = BLEND_REPLACE, .alpha = 255 },
+    [OVERLAY_SOCD]      = { .eval = overlay_eval_socd,      .blend = BLEND_REPLACE, .alpha = 255 },
+};
+static bool overlays_animating = false;
+
+static void overlay_changed(overlay_id_t id) {
+    __dmb();
+    overlays[id].req++;
+    inputs_changed();
+}
+
+static inline void overlay_set(overlay_t *o, int physical, uint8_t r, uint8_t g, uint8_t b) {
+    if (physical < 0 || physical >= LED_COUNT) return;
+    o->cover[physical >> 5] |= 1u << (physical & 31);
+    o->rgb[physical * 3 + 0] = r;
+    o->rgb[physical * 3 + 1] = g;
+    o->rgb[physical * 3 + 2] = b;
+}
+
+static inline void overlay_set_key(overlay_t *o, int logical, uint8_t r, uint8_t g, uint8_t b) {
+    if (logical < 0 || logical >= KEY_LED_COUNT) return;
+    overlay_set(o, led_position_map[logical], r, g, b);
+}
+
+static inline void overlay_set_ambient(overlay_t *o, int idx, uint8_t r, uint8_t g, uint8_t b) {
+#if AMBIENT_LED_COUNT > 0
+    if (idx < 0 || idx >= AMBIENT_LED_COUNT) return;
+    overlay_set(o, ambient_led_map[idx], r, g, b);
+#else
+    (void)o; (void)idx; (void)r; (void)g; (void)b;
+#endif
+}
+
+static inline uint8_t add_sat(uint8_t a, uint8_t b) {
+    uint16_t v = (uint16_t)a + b;
+    return v > 255 ? 255 : (uint8_t)v;
+}
+
+static inline uint8_t mix_alpha(uint8_t dst, uint8_t src, uint8_t alpha) {
+    return (uint8_t)(((uint16_t)src * alpha + (uint16_t)dst * (255u - alpha)) / 255u);
+}
+
+static void overlays_composite(uint32_t now_ms) {
+    overlays_animating = false;
+    for (int id = 0; id < OVERLAY_COUNT; id++) {
+        overlay_t *o = &overlays[id];
+        const uint8_t req = o->req;
+        const bool changed = req != o->seen;
+        if (changed || o->animating) {
+            o->seen = req;
+            __dmb();
+            memset(o->cover, 0, sizeof(o->cover));
+            o->animating = o->eval(o, changed, now_ms);
+        }
+        if (o->animating) overlays_animating = true;
+
+        for (int w = 0; w < COVER_WORDS; w++) {
+            uint32_t bits = o->cover[w];
+            while (bits) {
+                const int i = w * 32 + __builtin_ctz(bits);
+                bits &= bits - 1;
+                uint8_t *dst = &led_buffer[i * 3];
+                const uint8_t *src = &o->rgb[i * 3];
+                for (int c = 0; c < 3; c++) {
+                    switch (o->blend) {
+                        case BLEND_ADD:   dst[c] = add_sat(dst[c], src[c]); break;
+                        case BLEND_ALPHA: dst[c] = mix_alpha(dst[c], src[c], o->alpha); break;
+                        default:          dst[c] = src[c]; break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// SignalRGB streaming data on enabled zones. SignalRGB sends data in
+// logical order, so it is mapped like the effects.
+static bool overlay_eval_signalrgb(overlay_t *o, bool changed, uint32_t now_ms) {
+    (void)changed; (void)now_ms;
+    if (!signalrgb_valid) return false;
+    // Zone 0: main keys
+    if (streaming_zones_mask & 0x01) {
+        for (int i = 0; i < KEY_LED_COUNT && i < SENSOR_COUNT; i++) {
+            overlay_set_key(o, i,
+                signalrgb_buffer[i * 3 + 0],
+                signalrgb_buffer[i * 3 + 1],
+                signalrgb_buffer[i * 3 + 2]);
+        }
+    }
+    // Zone 1: ambient strip
+    if ((streaming_zones_mask & 0x02) && AMBIENT_LED_COUNT > 0) {
+        for (int i = 0; i < AMBIENT_LED_COUNT; i++) {
+            int src_idx = SENSOR_COUNT + i;
+            if (src_idx < LED_COUNT) {
+                overlay_set_ambient(o, i,
+                    signalrgb_buffer[src_idx * 3 + 0],
+                    signalrgb_buffer[src_idx * 3 + 1],
+                    signalrgb_buffer[src_idx * 3 + 2]);
+            }
+        }
+    }
+    return false;
+}
+
+// Paint overlay - any non-black LED in paint_overlay_buffer overrides the
+// effect. Paint works on top of any effect and persists across effect
+// changes; the buffer is in logical order.
+static bool overlay_eval_paint(overlay_t *o, bool changed, uint32_t now_ms) {
+    (void)changed; (void)now_ms;
     for (int logical = 0; logical < KEY_LED_COUNT; logical++) {
         uint8_t r = paint_overlay_buffer[logical * 3 + 0];
         uint8_t g = paint_overlay_buffer[logical * 3 + 1];
         uint8_t b = paint_overlay_buffer[logical * 3 + 2];
-        if (r != 0 || g != 0 || b != 0) {
-            uint8_t physical = led_position_map[logical];
-            if (physical < LED_COUNT) {
-                led_buffer[physical * 3 + 0] = r;
-                led_buffer[physical * 3 + 1] = g;
-                led_buffer[physical * 3 + 2] = b;
-            }
-        }
+        if (r != 0 || g != 0 || b != 0) overlay_set_key(o, logical, r, g, b);
     }
-#if AMBIENT_LED_COUNT > 0
     for (int i = 0; i < AMBIENT_LED_COUNT; i++) {
         int logical = KEY_LED_COUNT + i;
         uint8_t r = paint_overlay_buffer[logical * 3 + 0];
         uint8_t g = paint_overlay_buffer[logical * 3 + 1];
         uint8_t b = paint_overlay_buffer[logical * 3 + 2];
-        if (r != 0 || g != 0 || b != 0) {
-            uint8_t physical = ambient_led_map[i];
-            if (physical < LED_COUNT) {
-                led_buffer[physical * 3 + 0] = r;
-                led_buffer[physical * 3 + 1] = g;
-                led_buffer[physical * 3 + 2] = b;
-            }
-        }
+        if (r != 0 || g != 0 || b != 0) overlay_set_ambient(o, i, r, g, b);
     }
-#endif
+    return false;
+}
 
-    // Apply layer indicator overlay on ambient strip (Mina) when on non-base layer
-#if AMBIENT_LED_COUNT > 0
-    if (layer_indicator_forced && current_layer_for_indicator > 0 && current_layer_for_indicator < 4) {
-        uint8_t lr = layer_colors[current_layer_for_indicator][0];
-        uint8_t lg = layer_colors[current_layer_for_indicator][1];
-        uint8_t lb = layer_colors[current_layer_for_indicator][2];
-        if (lr > 0 || lg > 0 || lb > 0) {
-            for (int i = 0; i < AMBIENT_LED_COUNT; i++) {
-                set_ambient_idx_rgb(i, lr, lg, lb);
-            }
-        }
+// Layer indicator on the ambient strip (Mina) while on a non-base layer
+static bool overlay_eval_layer(overlay_t *o, bool changed, uint32_t now_ms) {
+    (void)changed; (void)now_ms;
+    const uint8_t layer = current_layer_for_indicator;
+    if (layer == 0 || layer >= 4) return false;
+    uint8_t lr = layer_colors[layer][0];
+    uint8_t lg = layer_colors[layer][1];
+    uint8_t lb = layer_colors[layer][2];
+    if (lr == 0 && lg == 0 && lb == 0) return false;
+    for (int i = 0; i < AMBIENT_LED_COUNT; i++) {
+        overlay_set_ambient(o, i, lr, lg, lb);
     }
-#endif
+    return false;
+}
 
-    // Apply caps lock overlay if enabled and active (on top of paint)
-    if (caps_overlay_enabled && caps_overlay_active) {
+// Caps lock indicator, when enabled and active
+static bool overlay_eval_caps(overlay_t *o, bool changed, uint32_t now_ms) {
+    (void)changed; (void)now_ms;
+    if (!caps_overlay_enabled || !caps_overlay_active) return false;
 #ifdef CAPS_LOCK_LED_INDEX
 #if HAS_AMBIENT_CAPS_INDICATOR && AMBIENT_LED_COUNT > 0
-        // Mina: highlight ambient strip when caps lock is on
-        for (int i = 0; i < AMBIENT_LED_COUNT && i < AMBIENT_CAPS_INDICATOR_COUNT; i++) {
-            set_ambient_idx_rgb(i, caps_color_r, caps_color_g, caps_color_b);
-        }
+    // Mina: highlight ambient strip when caps lock is on
+    for (int i = 0; i < AMBIENT_LED_COUNT && i < AMBIENT_CAPS_INDICATOR_COUNT; i++) {
+        overlay_set_ambient(o, i, caps_color_r, caps_color_g, caps_color_b);
+    }
 #else
-        // Taki: highlight only the caps lock key LED
-        uint8_t caps_physical = led_position_map[CAPS_LOCK_LED_INDEX];
-        if (caps_physical < LED_COUNT) {
-            led_buffer[caps_physical * 3 + 0] = caps_color_r;
-            led_buffer[caps_physical * 3 + 1] = caps_color_g;
-            led_buffer[caps_physical * 3 + 2] = caps_color_b;
-        }
+    // Taki: highlight only the caps lock key LED
+    overlay_set_key(o, CAPS_LOCK_LED_INDEX, caps_color_r, caps_color_g, caps_color_b);
 #endif
+#else
+    (void)o;
 #endif
-    }
-    
-    // SOCD toggle animation overlay — highest priority on ambient strip
+    return false;
+}
+
+// SOCD toggle animation on the ambient strip: a wave out from the centre,
+// then a fade. lighting_socd_animation() (re)starts it.
+static bool overlay_eval_socd(overlay_t *o, bool changed, uint32_t now_ms) {
 #if AMBIENT_LED_COUNT > 0
-    if (socd_anim_active) {
-        uint32_t now_ms = to_ms_since_boot(get_absolute_time());
-        uint8_t half = AMBIENT_LED_COUNT / 2;  // center split (4 for 8 LEDs)
-        uint8_t cr = socd_anim_green ? 0 : 255;
-        uint8_t cg = socd_anim_green ? 255 : 0;
-
-        if (socd_anim_step < half) {
-            // Propagation phase: 80ms per step, light 2 LEDs at a time from center
-            if (now_ms - socd_anim_last_ms >= 80) {
-                socd_anim_step++;
-                socd_anim_last_ms = now_ms;
-            }
-            // Black out ambient first, then light up the reached LEDs
-            for (int i = 0; i < AMBIENT_LED_COUNT; i++) {
-                set_ambient_idx_rgb(i, 0, 0, 0);
-            }
-            for (uint8_t s = 0; s < socd_anim_step; s++) {
-                int left = (half - 1) - s;
-                int right = half + s;
-                if (left >= 0) set_ambient_idx_rgb(left, cr, cg, 0);
-                if (right < AMBIENT_LED_COUNT) set_ambient_idx_rgb(right, cr, cg, 0);
-            }
-        } else if (socd_anim_fade > 0) {
-            // Fade phase: decrement brightness
-            if (now_ms - socd_anim_last_ms >= 8) {
-                socd_anim_fade = (socd_anim_fade > 12) ? socd_anim_fade - 12 : 0;
-                socd_anim_last_ms = now_ms;
-            }
-            uint8_t fr = (uint8_t)((uint16_t)cr * socd_anim_fade / 255);
-            uint8_t fg = (uint8_t)((uint16_t)cg * socd_anim_fade / 255);
-            for (int i = 0; i < AMBIENT_LED_COUNT; i++) {
-                set_ambient_idx_rgb(i, fr, fg, 0);
-            }
-        } else {
-            // Animation complete
-            socd_anim_active = false;
+    if (changed) {
+        socd_anim_active = true;
+        socd_anim_green = socd_anim_req_green;
+        socd_anim_step = 0;
+        socd_anim_fade = 255;
+        socd_anim_last_ms = now_ms;
+    }
+    if (!socd_anim_active) return false;
+
+    uint8_t half = AMBIENT_LED_COUNT / 2;  // center split (4 for 8 LEDs)
+    uint8_t cr = socd_anim_green ? 0 : 255;
+    uint8_t cg = socd_anim_green ? 255 : 0;
+
+    if (socd_anim_step < half) {
+        // Propagation phase: 80ms per step, light 2 LEDs at a time from center
+        if (now_ms - socd_anim_last_ms >= 80) {
+            socd_anim_step++;
+            socd_anim_last_ms = now_ms;
+        }
+        // Black out ambient first, then light up the reached LEDs
+        for (int i = 0; i < AMBIENT_LED_COUNT; i++) {
+            overlay_set_ambient(o, i, 0, 0, 0);
+        }
+        for (uint8_t s = 0; s < socd_anim_step; s++) {
+            int left = (half - 1) - s;
+            int right = half + s;
+            if (left >= 0) overlay_set_ambient(o, left, cr, cg, 0);
+            if (right < AMBIENT_LED_COUNT) overlay_set_ambient(o, right, cr, cg, 0);
         }
+        return true;
     }
+    if (socd_anim_fade > 0) {
+        // Fade phase: decrement brightness
+        if (now_ms - socd_anim_last_ms >= 8) {
+            socd_anim_fade = (socd_anim_fade > 12) ? socd_anim_fade - 12 : 0;
+            socd_anim_last_ms = now_ms;
+        }
+        uint8_t fr = (uint8_t)((uint16_t)cr * socd_anim_fade / 255);
+        uint8_t fg = (uint8_t)((uint16_t)cg * socd_anim_fade / 255);
+        for (int i = 0; i < AMBIENT_LED_COUNT; i++) {
+            overlay_set_ambient(o, i, fr, fg, 0);
+        }
+        return true;
+    }
+    // Animation complete
+    socd_anim_active = false;
+#else
+    (void)o; (void)changed; (void)now_ms;
 #endif
+    return false;
+}
+
+static void output_leds(uint32_t now_ms) {
+    overlays_composite(now_ms);
 
     // Output in physical strip order.
     // Some PCBs route WS2812 data into the *opposite* end of the LED chain.
@@ -295,19 +682,22 @@ static void output_leds(void) {
     //
     // To fix that without changing led_position_map/ambient_led_map, boards
     // can define LED_STRIP_REVERSED=1 in their config.h.
+    uint32_t *words = frame_words[frame_render];
 #if defined(LED_STRIP_REVERSED) && (LED_STRIP_REVERSED)
-    for (int i = LED_COUNT - 1; i >= 0; i--) {
-        send_pixel(led_buffer[i * 3 + 0],
-                   led_buffer[i * 3 + 1],
-                   led_buffer[i * 3 + 2]);
+    for (int i = LED_COUNT - 1, n = 0; i >= 0; i--, n++) {
+        words[n] = encode_pixel(led_buffer[i * 3 + 0],
+                                led_buffer[i * 3 + 1],
+                                led_buffer[i * 3 + 2]);
     }
 #else
     for (int i = 0; i < LED_COUNT; i++) {
-        send_pixel(led_buffer[i * 3 + 0],
-                   led_buffer[i * 3 + 1],
-                   led_buffer[i * 3 + 2]);
+        words[i] = encode_pixel(led_buffer[i * 3 + 0],
+                                led_buffer[i * 3 + 1],
+                                led_buffer[i * 3 + 2]);
     }
 #endif
+    frame_pending = true;
+    ws2812_kick();
 }
 
 void lighting_init(void)
@@ -317,50 +707,51 @@ void lighting_init(void)
     uint offset = pio_add_program(pio, &ws2812_program);
     // initialize with 800kHz freq, uses function from generated header
     ws2812_program_init(pio, sm, offset, LED_PIN, 800000, false);
+
+    // DMA: 32-bit words from the frame buffer into the TX FIFO, paced by its DREQ
+    ws2812_dma = (uint)dma_claim_unused_channel(true);
+    dma_channel_config dc = dma_channel_get_default_config(ws2812_dma);
+    channel_config_set_transfer_data_size(&dc, DMA_SIZE_32);
+    channel_config_set_read_increment(&dc, true);
+    channel_config_set_write_increment(&dc, false);
+    channel_config_set_dreq(&dc, pio_get_dreq(pio, sm, true));
+    dma_channel_configure(ws2812_dma, &dc, &pio->txf[sm], NULL, 0, false);
     
+    output_lut_rebuild();
+
     // Initialize LED buffers to off
     memset(led_buffer, 0, sizeof(led_buffer));
     memset(static_led_buffer, 0, sizeof(static_led_buffer));
     memset(paint_overlay_buffer, 0, sizeof(paint_overlay_buffer));
     
+    inputs_changed();
+
     // Set default gradient (red -> blue)
     gradient_colors[0] = 255; gradient_colors[1] = 0; gradient_colors[2] = 0;
     gradient_colors[3] = 0; gradient_colors[4] = 0; gradient_colors[5] = 255;
     gradient_num_colors = 2;
+
+    // Key positions are fixed; the gradient projection follows its parameters
+    key_geometry_init();
+    key_gradient_update();
     
     // Clear reactive keys
     memset(reactive_keys, 0, sizeof(reactive_keys));
 }
 
-// convenience: convert 8-bit r,g,b to 24-bit GRB value and send
-void lighting_set_pixel_rgb(int idx, uint8_t r, uint8_t g, uint8_t b)
-{
-    (void) idx; // ws2812 pio program writes directly to the stream; we don't use index for addressing
-    send_pixel(r, g, b);
-}
-
-void lighting_set_all_rgb(uint8_t r, uint8_t g, uint8_t b)
-{
-    for (int i = 0; i < LED_COUNT; ++i) {
-        send_pixel(r, g, b);
-    }
-}
-
 void lighting_set_max_brightness_percent(uint8_t percent)
 {
-    if (percent == 0) {
-        g_brightness_scale = 0.0f;
-    } else if (percent >= 100) {
-        g_brightness_scale = 1.0f;
-    } else {
-        g_brightness_scale = (float)percent / 100.0f;
-    }
+    if (percent > 100) percent = 100;
+    g_brightness_percent = percent;
+    output_lut_rebuild();
+    inputs_changed();
 }
 
 void lighting_set_effect(led_effect_t effect)
 {
     current_effect = effect;
-    effect_phase = 0;
+    effect_restart_req++;
+    inputs_changed();
     printf("Effect set to %d\n", effect);
 }
 
@@ -377,11 +768,13 @@ void lighting_set_effect_direction(uint8_t direction)
 void lighting_set_effect_color1(uint8_t r, uint8_t g, uint8_t b)
 {
     color1_r = r; color1_g = g; color1_b = b;
+    inputs_changed();
 }
 
 void lighting_set_effect_color2(uint8_t r, uint8_t g, uint8_t b)
 {
     color2_r = r; color2_g = g; color2_b = b;
+    inputs_changed();
 }
 
 void lighting_set_gradient(uint8_t num_colors, const uint8_t *colors)
@@ -390,6 +783,7 @@ void lighting_set_gradient(uint8_t num_colors, const uint8_t *colors)
     if (num_colors < 1) num_colors = 1;
     gradient_num_colors = num_colors;
     memcpy(gradient_colors, colors, num_colors * 3);
+    inputs_changed();
 }
 
 void lighting_set_gradient_params(uint8_t orientation, uint16_t rotation_deg)
@@ -398,6 +792,10 @@ void lighting_set_gradient_params(uint8_t orientation, uint16_t rotation_deg)
     if (rotation_deg > 360) rotation_deg = (uint16_t)(rotation_deg % 360);
     gradient_orientation = orientation;
     gradient_rotation_deg = rotation_deg;
+    gradient_rot_cos = sin_deg_q15(90 - (int32_t)rotation_deg);
+    gradient_rot_sin = sin_deg_q15(rotation_deg);
+    key_gradient_update();
+    inputs_changed();
 }
 
 void lighting_get_gradient(uint8_t *num_colors_out, uint8_t *colors_out, uint16_t colors_out_len)
@@ -426,6 +824,7 @@ void lighting_set_led_buffer(const uint8_t *buffer, uint16_t len)
     // and output_leds() applies the paint overlay from paint_overlay_buffer
     if (len > sizeof(static_led_buffer)) len = sizeof(static_led_buffer);
     memcpy(static_led_buffer, buffer, len);
+    inputs_changed();
 }
 
 void lighting_set_paint_led(uint8_t led_index, uint8_t r, uint8_t g, uint8_t b)
@@ -436,18 +835,21 @@ void lighting_set_paint_led(uint8_t led_index, uint8_t r, uint8_t g, uint8_t b)
     paint_overlay_buffer[led_index * 3 + 0] = r;
     paint_overlay_buffer[led_index * 3 + 1] = g;
     paint_overlay_buffer[led_index * 3 + 2] = b;
+    overlay_changed(OVERLAY_PAINT);
 }
 
 void lighting_clear_paint_overlay(void)
 {
     // Clear all painted LEDs - returns to base effect
     memset(paint_overlay_buffer, 0, sizeof(paint_overlay_buffer));
+    overlay_changed(OVERLAY_PAINT);
 }
 
 void lighting_set_streaming_zones(uint8_t zone_mask)
 {
     // Two-zone hardware: accept only main + ambient bits.
     streaming_zones_mask = zone_mask & 0x03;
+    overlay_changed(OVERLAY_SIGNALRGB);
 }
 
 uint8_t lighting_get_streaming_zones(void)
@@ -462,12 +864,16 @@ void lighting_set_signalrgb_buffer(const uint8_t *buffer, uint16_t len)
     memcpy(signalrgb_buffer, buffer, len);
     // If host sends partial, keep rest as-is; still consider it valid.
     signalrgb_valid = true;
+    overlay_changed(OVERLAY_SIGNALRGB);
 }
 
 void lighting_notify_keypress(uint8_t key_idx)
 {
-    if (key_idx < SENSOR_COUNT) {
-        reactive_keys[key_idx] = 255;  // Full brightness on press
+    // Only Reactive shows presses; any other effect keeps skipping frames
+    // while typing (current_effect is written on this core)
+    if (key_idx < SENSOR_COUNT && current_effect == LED_EFFECT_REACTIVE) {
+        key_press_count[key_idx]++;
+        inputs_changed();
     }
 }
 
@@ -481,15 +887,14 @@ static void lerp_color(uint8_t r1, uint8_t g1, uint8_t b1,
     *b = b1 + ((b2 - b1) * t) / 255;
 }
 
-// Wrap float to 0-1 range (for seamless looping effects)
-static inline float wrap01f(float x) {
-    x = fmodf(x, 1.0f);
-    if (x < 0.0f) x += 1.0f;
-    return x;
+// Blend a -> b by frac (Q16), rounded down
+static inline uint8_t lerp_q16(uint8_t a, uint8_t b, uint32_t frac) {
+    return (uint8_t)(((int32_t)a * Q16_ONE + ((int32_t)b - (int32_t)a) * (int32_t)frac) >> 16);
 }
 
-// Sample gradient palette cyclically (wraps around for seamless animation)
-static void gradient_sample_cyclic_palette(float t, const uint8_t *palette_colors, uint8_t palette_num_colors,
+// Sample gradient palette cyclically at t (Q16, any value: wraps around for
+// seamless animation)
+static void gradient_sample_cyclic_palette(int32_t t, const uint8_t *palette_colors, uint8_t palette_num_colors,
                                           uint8_t *r, uint8_t *g, uint8_t *b) {
     if (palette_num_colors == 0 || !palette_colors) {
         *r = *g = *b = 0;
@@ -502,22 +907,35 @@ static void gradient_sample_cyclic_palette(float t, const uint8_t *palette_color
         return;
     }
 
-    t = wrap01f(t);
-    float scaled = t * (float)palette_num_colors;
-    int idx1 = (int)floorf(scaled);
-    float frac = scaled - (float)idx1;
-
-    int n = (int)palette_num_colors;
-    idx1 = idx1 % n;
-    if (idx1 < 0) idx1 += n;
-    int idx2 = (idx1 + 1) % n;
+    // Wrap to 0..1 (two's complement handles negative t)
+    const uint32_t scaled = ((uint32_t)t & 0xFFFFu) * palette_num_colors;
+    const int idx1 = (int)(scaled >> 16);
+    const uint32_t frac = scaled & 0xFFFFu;
+    const int idx2 = (idx1 + 1) % palette_num_colors;
 
     const uint8_t *c1 = &palette_colors[idx1 * 3];
     const uint8_t *c2 = &palette_colors[idx2 * 3];
 
-    *r = (uint8_t)((float)c1[0] + ((float)c2[0] - (float)c1[0]) * frac);
-    *g = (uint8_t)((float)c1[1] + ((float)c2[1] - (float)c1[1]) * frac);
-    *b = (uint8_t)((float)c1[2] + ((float)c2[2] - (float)c1[2]) * frac);
+    *r = lerp_q16(c1[0], c2[0], frac);
+    *g = lerp_q16(c1[1], c2[1], frac);
+    *b = lerp_q16(c1[2], c2[2], frac);
+}
+
+// Sample the gradient stops at pos (Q16, 0..1), first stop to last
+static void gradient_sample_linear(int32_t pos, uint8_t *r, uint8_t *g, uint8_t *b) {
+    const uint32_t scaled = (uint32_t)clamp01_q16(pos) * (uint32_t)(gradient_num_colors - 1);
+    int idx1 = (int)(scaled >> 16);
+    const uint32_t frac = scaled & 0xFFFFu;
+    if (idx1 >= gradient_num_colors) idx1 = gradient_num_colors - 1;
+    int idx2 = idx1 + 1;
+    if (idx2 >= gradient_num_colors) idx2 = gradient_num_colors - 1;
+
+    const uint8_t *c1 = &gradient_colors[idx1 * 3];
+    const uint8_t *c2 = &gradient_colors[idx2 * 3];
+
+    *r = lerp_q16(c1[0], c2[0], frac);
+    *g = lerp_q16(c1[1], c2[1], frac);
+    *b = lerp_q16(c1[2], c2[2], frac);
 }
 
 // HSV to RGB helper
@@ -547,15 +965,44 @@ static void hsv_to_rgb(uint8_t h, uint8_t s, uint8_t v, uint8_t *r, uint8_t *g,
 
 void lighting_update(void)
 {
+    // A frame that found the line busy goes out as soon as it is free
+    ws2812_kick();
+
     uint32_t now = to_ms_since_boot(get_absolute_time());
-    
-    // Calculate update interval based on speed (faster speed = shorter interval)
-    uint32_t interval = 50 - (effect_speed * 45 / 255);  // 5-50ms
-    if (now - last_update_ms < interval) return;
+
+    // Effects advance one phase step per 5-50 ms by speed (faster speed =
+    // shorter step) however often frames are rendered
+    uint32_t interval = 50 - (effect_speed * 45 / 255);
+    phase_acc_ms += now - last_update_ms;
     last_update_ms = now;
-    
-    // Advance phase
-    effect_phase += effect_direction ? -1 : 1;
+    uint32_t phase_steps = phase_acc_ms / interval;
+    phase_acc_ms -= phase_steps * interval;
+    if (phase_steps > 255) phase_steps = 255;   // output was off for a while
+
+    // Events from core0
+    if (effect_restart_req != effect_restart_seen) {
+        effect_restart_seen = effect_restart_req;
+        effect_phase = 0;
+    }
+    if (effect_direction) effect_phase -= phase_steps;
+    else effect_phase += phase_steps;
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        uint8_t n = key_press_count[i];
+        if (n != key_press_seen[i]) {
+            key_press_seen[i] = n;
+            reactive_keys[i] = 255;  // Full brightness on press
+        }
+    }
+
+    // Nothing changed: keep the frame on the strip, but resend it now and
+    // then so a glitched LED recovers
+    const uint32_t seq = input_seq;
+    const bool changed = seq != rendered_seq || overlays_animating || (phase_steps > 0 && frame_animated());
+    if (!changed && now - last_frame_ms < LED_REFRESH_MS) return;
+    __dmb();
+    rendered_seq = seq;
+    last_frame_ms = now;
     
     // Clear LED buffer before rendering - paint overlay will add painted LEDs on top
     memset(led_buffer, 0, sizeof(led_buffer));
@@ -615,22 +1062,21 @@ void lighting_update(void)
             bool forward = (effect_direction == 0);
             if (base_reverse) forward = !forward;
 
-            float phase = (float)effect_phase * 0.01f;
+            // 0.01 per step; the palette wraps every 100 steps
+            int32_t phase = (((int32_t)effect_phase % 100) * Q16_ONE) / 100;
             
-            // Key LEDs: use gradient_base_t for proper orientation handling
+            // Key LEDs: projected position respects the orientation setting
             for (int i = 0; i < KEY_LED_COUNT; i++) {
-                float x, y;
-                mina_taki_logical_xy(i, &x, &y);
-                float base_t = gradient_base_t(x, y);  // Respects orientation setting
-                float t = forward ? (base_t + phase) : (base_t - phase);
+                int32_t base_t = key_gradient_pos[i];
+                int32_t t = forward ? (base_t + phase) : (base_t - phase);
                 uint8_t r, g, b;
                 gradient_sample_cyclic_palette(t, gradient_colors, gradient_num_colors, &r, &g, &b);
                 set_key_logical_rgb(i, r, g, b);
             }
             // Ambient LEDs: use linear position along strip
             for (int i = 0; i < AMBIENT_LED_COUNT; i++) {
-                float pos = (AMBIENT_LED_COUNT <= 1) ? 0.5f : ((float)i / (float)(AMBIENT_LED_COUNT - 1));
-                float t = forward ? (pos + phase) : (pos - phase);
+                int32_t pos = strip_pos_q16(i, AMBIENT_LED_COUNT);
+                int32_t t = forward ? (pos + phase) : (pos - phase);
                 uint8_t r, g, b;
                 gradient_sample_cyclic_palette(t, gradient_colors, gradient_num_colors, &r, &g, &b);
                 set_ambient_idx_rgb(i, r, g, b);
@@ -641,24 +1087,25 @@ void lighting_update(void)
         case LED_EFFECT_RADIAL: {
             // Radial wave from center outward
             bool forward = (effect_direction == 0);
-            float phase = (float)effect_phase * 0.02f;
+            // 0.02 per step; the palette wraps every 50 steps
+            int32_t phase = (((int32_t)effect_phase % 50) * Q16_ONE) / 50;
             
             // Key LEDs: use distance from center (0.5, 0.5)
             for (int i = 0; i < KEY_LED_COUNT; i++) {
-                float x, y;
-                mina_taki_logical_xy(i, &x, &y);
-                float dx = x - 0.5f;
-                float dy = y - 0.5f;
-                float dist = sqrtf(dx*dx + dy*dy) * 1.414f;  // Normalize to ~0..1
-                float t = forward ? (dist + phase) : (dist - phase);
+                int32_t dist = geom_q16(key_geometry[i].radial);
+                int32_t t = forward ? (dist + phase) : (dist - phase);
                 uint8_t r, g, b;
                 gradient_sample_cyclic_palette(t, gradient_colors, gradient_num_colors, &r, &g, &b);
                 set_key_logical_rgb(i, r, g, b);
             }
             // Ambient LEDs: use linear position
             for (int i = 0; i < AMBIENT_LED_COUNT; i++) {
-                float pos = (AMBIENT_LED_COUNT <= 1) ? 0.0f : fabsf(((float)i / (float)(AMBIENT_LED_COUNT - 1)) - 0.5f) * 2.0f;
-                float t = forward ? (pos + phase) : (pos - phase);
+                int32_t pos = 0;
+                if (AMBIENT_LED_COUNT > 1) {
+                    int32_t off = strip_pos_q16(i, AMBIENT_LED_COUNT) - Q16_HALF;
+                    pos = (off < 0 ? -off : off) * 2;
+                }
+                int32_t t = forward ? (pos + phase) : (pos - phase);
                 uint8_t r, g, b;
                 gradient_sample_cyclic_palette(t, gradient_colors, gradient_num_colors, &r, &g, &b);
                 set_ambient_idx_rgb(i, r, g, b);
@@ -669,47 +1116,15 @@ void lighting_update(void)
         case LED_EFFECT_GRADIENT: {
             // Static gradient based on key position (uses orientation like Shego)
             for (int i = 0; i < KEY_LED_COUNT; i++) {
-                float x, y;
-                mina_taki_logical_xy(i, &x, &y);
-                // Use gradient_base_t which respects orientation setting
-                float pos = gradient_base_t(x, y);
-                float scaled = pos * (gradient_num_colors - 1);
-                int idx1 = (int)scaled;
-                int idx2 = idx1 + 1;
-                if (idx2 >= gradient_num_colors) idx2 = gradient_num_colors - 1;
-                float frac = scaled - idx1;
-                
-                uint8_t r1 = gradient_colors[idx1 * 3];
-                uint8_t g1 = gradient_colors[idx1 * 3 + 1];
-                uint8_t b1 = gradient_colors[idx1 * 3 + 2];
-                uint8_t r2 = gradient_colors[idx2 * 3];
-                uint8_t g2 = gradient_colors[idx2 * 3 + 1];
-                uint8_t b2 = gradient_colors[idx2 * 3 + 2];
-                
-                uint8_t r = r1 + (uint8_t)((float)(r2 - r1) * frac);
-                uint8_t g = g1 + (uint8_t)((float)(g2 - g1) * frac);
-                uint8_t b = b1 + (uint8_t)((float)(b2 - b1) * frac);
+                // Projected position respects the orientation setting
+                uint8_t r, g, b;
+                gradient_sample_linear(key_gradient_pos[i], &r, &g, &b);
                 set_key_logical_rgb(i, r, g, b);
             }
             // Ambient: gradient along strip
             for (int i = 0; i < AMBIENT_LED_COUNT; i++) {
-                float pos = (AMBIENT_LED_COUNT <= 1) ? 0.5f : ((float)i / (float)(AMBIENT_LED_COUNT - 1));
-                float scaled = pos * (gradient_num_colors - 1);
-                int idx1 = (int)scaled;
-                int idx2 = idx1 + 1;
-                if (idx2 >= gradient_num_colors) idx2 = gradient_num_colors - 1;
-                float frac = scaled - idx1;
-                
-                uint8_t r1 = gradient_colors[idx1 * 3];
-                uint8_t g1 = gradient_colors[idx1 * 3 + 1];
-                uint8_t b1 = gradient_colors[idx1 * 3 + 2];
-                uint8_t r2 = gradient_colors[idx2 * 3];
-                uint8_t g2 = gradient_colors[idx2 * 3 + 1];
-                uint8_t b2 = gradient_colors[idx2 * 3 + 2];
-                
-                uint8_t r = r1 + (uint8_t)((float)(r2 - r1) * frac);
-                uint8_t g = g1 + (uint8_t)((float)(g2 - g1) * frac);
-                uint8_t b = b1 + (uint8_t)((float)(b2 - b1) * frac);
+                uint8_t r, g, b;
+                gradient_sample_linear(strip_pos_q16(i, AMBIENT_LED_COUNT), &r, &g, &b);
                 set_ambient_idx_rgb(i, r, g, b);
             }
             break;
@@ -718,18 +1133,18 @@ void lighting_update(void)
         case LED_EFFECT_RAINBOW: {
             // Rainbow based on key position
             for (int i = 0; i < KEY_LED_COUNT; i++) {
-                float x, y;
-                mina_taki_logical_xy(i, &x, &y);
-                // Use X + Y for diagonal rainbow
-                uint8_t hue = (uint8_t)(((int)((x + y) * 128) + effect_phase) % 256);
+                int32_t x = geom_q16(key_geometry[i].x);
+                int32_t y = geom_q16(key_geometry[i].y);
+                // Use X + Y for diagonal rainbow: (x + y) * 128 hue steps
+                uint8_t hue = (uint8_t)((((x + y) >> 9) + effect_phase) % 256);
                 uint8_t r, g, b;
                 hsv_to_rgb(hue, 255, 255, &r, &g, &b);
                 set_key_logical_rgb(i, r, g, b);
             }
             // Ambient: rainbow along strip
             for (int i = 0; i < AMBIENT_LED_COUNT; i++) {
-                float pos = (AMBIENT_LED_COUNT <= 1) ? 0.5f : ((float)i / (float)(AMBIENT_LED_COUNT - 1));
-                uint8_t hue = (uint8_t)(((int)(pos * 256) + effect_phase) % 256);
+                int32_t pos = strip_pos_q16(i, AMBIENT_LED_COUNT);
+                uint8_t hue = (uint8_t)(((pos >> 8) + effect_phase) % 256);
                 uint8_t r, g, b;
                 hsv_to_rgb(hue, 255, 255, &r, &g, &b);
                 set_ambient_idx_rgb(i, r, g, b);
@@ -741,9 +1156,8 @@ void lighting_update(void)
             // Keys light up when pressed, then fade
             // Decay reactive keys
             for (int i = 0; i < SENSOR_COUNT; i++) {
-                if (reactive_keys[i] > 0) {
-                    reactive_keys[i] = (reactive_keys[i] > 8) ? reactive_keys[i] - 8 : 0;
-                }
+                uint32_t decay = 8u * phase_steps;
+                reactive_keys[i] = (reactive_keys[i] > decay) ? (uint8_t)(reactive_keys[i] - decay) : 0;
             }
             
             // Apply reactive colors to key LEDs
@@ -762,46 +1176,65 @@ void lighting_update(void)
             break;
     }
 
-    // Overlay SignalRGB streaming data on enabled zones.
-    // SignalRGB sends data in logical order, so we need to map it
-    if (signalrgb_valid && (streaming_zones_mask & 0x03)) {
-        // Zone 0: main keys
-        if (streaming_zones_mask & 0x01) {
-            for (int i = 0; i < KEY_LED_COUNT && i < SENSOR_COUNT; i++) {
-                set_key_logical_rgb(i, 
-                    signalrgb_buffer[i * 3 + 0],
-                    signalrgb_buffer[i * 3 + 1],
-                    signalrgb_buffer[i * 3 + 2]);
-            }
-        }
-        // Zone 1: ambient strip
-        if ((streaming_zones_mask & 0x02) && AMBIENT_LED_COUNT > 0) {
-            for (int i = 0; i < AMBIENT_LED_COUNT; i++) {
-                int src_idx = SENSOR_COUNT + i;
-                if (src_idx < LED_COUNT) {
-                    set_ambient_idx_rgb(i,
-                        signalrgb_buffer[src_idx * 3 + 0],
-                        signalrgb_buffer[src_idx * 3 + 1],
-                        signalrgb_buffer[src_idx * 3 + 2]);
-                }
-            }
+    output_leds(now);
+}
+
+void lighting_set_output_enabled(bool on) {
+    output_enabled = on;
+    // A strip that was unpowered lost its frame; send it again
+    if (on) inputs_changed();
+}
+
+// Core1: one lighting_update() per frame period, on a fixed clock
+static void lighting_core1_main(void) {
+    // Flash writes on core0 park this core (lighting_flash_lockout_begin)
+    multicore_lockout_victim_init();
+    const uint32_t frame_us = 1000000u / LIGHTING_FPS;
+    absolute_time_t next = get_absolute_time();
+    bool blanked = true;
+    while (true) {
+        if (output_enabled) {
+            blanked = false;
+            lighting_update();
+        } else if (!blanked) {
+            // Output turned off: leave the strip dark, not on its last frame
+            blanked = ws2812_blank();
         }
+        next = delayed_by_us(next, frame_us);
+        // A frame that overran restarts the clock rather than bursting to catch up
+        if (absolute_time_diff_us(get_absolute_time(), next) < 0) next = get_absolute_time();
+        sleep_until(next);
     }
+}
+
+void lighting_start(void) {
+    if (core1_running) return;
+    last_update_ms = to_ms_since_boot(get_absolute_time());
+    core1_running = true;
+    multicore_launch_core1_with_stack(lighting_core1_main, core1_stack, sizeof(core1_stack));
+}
+
+void lighting_flash_lockout_begin(void) {
+    if (core1_running) multicore_lockout_start_blocking();
+}
 
-    output_leds();
+void lighting_flash_lockout_end(void) {
+    if (core1_running) multicore_lockout_end_blocking();
 }
 
 // ========================================
 // GETTERS FOR FLASH STORAGE
 // ========================================
 void lighting_get_led_buffer(uint8_t *buffer, uint16_t len) {
-    if (buffer && len >= sizeof(led_buffer)) {
-        memcpy(buffer, led_buffer, sizeof(led_buffer));
+    // The host-sent static colours (what lighting_set_led_buffer() restores);
+    // led_buffer itself is core1's render target
+    if (buffer && len >= sizeof(static_led_buffer)) {
+        memcpy(buffer, static_led_buffer, sizeof(static_led_buffer));
     }
 }
 
 uint8_t lighting_get_brightness(void) {
-    return (uint8_t)(g_brightness_scale * 100.0f);
+    return g_brightness_percent;
 }
 
 uint8_t lighting_get_effect(void) {
@@ -831,12 +1264,14 @@ void lighting_get_effect_color2(uint8_t *r, uint8_t *g, uint8_t *b) {
 void lighting_set_caps_lock_overlay(bool enabled, bool active) {
     caps_overlay_enabled = enabled;
     caps_overlay_active = active;
+    overlay_changed(OVERLAY_CAPS);
 }
 
 void lighting_set_caps_lock_color(uint8_t r, uint8_t g, uint8_t b) {
     caps_color_r = r;
     caps_color_g = g;
     caps_color_b = b;
+    overlay_changed(OVERLAY_CAPS);
 }
 
 // Layer indicator functions
@@ -846,6 +1281,7 @@ void lighting_set_layer_color(uint8_t layer, uint8_t r, uint8_t g, uint8_t b) {
         layer_colors[layer][0] = r;
         layer_colors[layer][1] = g;
         layer_colors[layer][2] = b;
+        overlay_changed(OVERLAY_LAYER);
     }
 }
 
@@ -862,13 +1298,9 @@ void lighting_get_layer_color(uint8_t layer, uint8_t *r, uint8_t *g, uint8_t *b)
 }
 
 void lighting_set_active_layer(uint8_t layer) {
+    // Base layer, or a layer without a colour, shows no indicator
     current_layer_for_indicator = layer < 4 ? layer : 0;
-    if (layer == 0) {
-        layer_indicator_forced = false;
-        return;
-    }
-    bool has_color = layer < 4 && (layer_colors[layer][0] > 0 || layer_colors[layer][1] > 0 || layer_colors[layer][2] > 0);
-    layer_indicator_forced = has_color;
+    overlay_changed(OVERLAY_LAYER);
 }
 
 uint8_t lighting_get_active_layer(void) {
@@ -877,11 +1309,9 @@ uint8_t lighting_get_active_layer(void) {
 
 void lighting_socd_animation(bool enabled) {
 #if AMBIENT_LED_COUNT > 0
-    socd_anim_active = true;
-    socd_anim_green = enabled;
-    socd_anim_step = 0;
-    socd_anim_fade = 255;
-    socd_anim_last_ms = to_ms_since_boot(get_absolute_time());
+    // core1 restarts the animation when it sees the overlay change
+    socd_anim_req_green = enabled;
+    overlay_changed(OVERLAY_SOCD);
 #else
     (void)enabled;
 #endif
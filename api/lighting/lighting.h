@@ -23,8 +23,18 @@ typedef enum {
 // BASIC FUNCTIONS
 // ========================================
 void lighting_init(void);
-void lighting_set_pixel_rgb(int idx, uint8_t r, uint8_t g, uint8_t b);
-void lighting_set_all_rgb(uint8_t r, uint8_t g, uint8_t b);
+
+// Run frames on core1 at LIGHTING_FPS from now on. Everything else in this
+// header stays on core0.
+void lighting_start(void);
+
+// Render and send frames (follows the LED power gate). Turning output off
+// sends one black frame, so boards without a gate go dark too.
+void lighting_set_output_enabled(bool on);
+
+// Core1 runs from flash: wrap flash erase/program in these
+void lighting_flash_lockout_begin(void);
+void lighting_flash_lockout_end(void);
 
 // Set maximum brightness cap 0..100 percent. Use 100 for no cap.
 void lighting_set_max_brightness_percent(uint8_t percent);
@@ -53,7 +63,7 @@ void lighting_set_gradient(uint8_t num_colors, const uint8_t *colors);
 // rotation_deg: 0-360 degrees (overrides orientation if non-zero)
 void lighting_set_gradient_params(uint8_t orientation, uint16_t rotation_deg);
 
-// Call periodically from main loop to update animated effects
+// Render one frame if anything changed; run by core1 once per frame period
 void lighting_update(void);
 
 // Store LED buffer for static mode (host sends full LED array)
@@ -25,6 +25,16 @@
 
 // HID/raw handler for vendor commands
 #include "hid_reports.h"
+#include "keyboard_report.h"
+#include "hid_queue.h"
+#include "hid_cmd.h"
+#include "adc_snapshot.h"
+#include "raw_tx.h"
+#include "config_image.h"
+#include "sof_align.h"
+#include "latency.h"
+#include "notify.h"
+#include "consumer_report.h"
 
 // Modern profile storage (app protocol 0x70+)
 #include "profiles.h"
@@ -32,6 +42,10 @@
 // SOCD + encoder
 #include "socd.h"
 #include "encoder.h"
+#include "midi.h"
+#include "two_stage.h"
+#include "layer_actuation.h"
+#include "mouse.h"
 
 // LED control
 #include "lighting.h"
@@ -93,16 +107,6 @@ static uint8_t get_keycode(uint8_t layer, uint8_t sensor_idx) {
     return 0;
 }
 
-// Check if keycode is a modifier (0xE0-0xE7)
-static inline bool is_modifier_keycode(uint8_t kc) {
-    return kc >= HID_KEY_CONTROL_LEFT && kc <= HID_KEY_GUI_RIGHT;
-}
-
-// Get modifier bit for a modifier keycode
-static inline uint8_t get_modifier_bit(uint8_t kc) {
-    return 1 << (kc - HID_KEY_CONTROL_LEFT);
-}
-
 // Check if keycode is an MO layer key (0xA8-0xAA)
 static inline bool is_mo_keycode(uint8_t kc) {
     return kc >= 0xA8 && kc <= 0xAA;
@@ -115,16 +119,15 @@ static inline bool is_tg_keycode(uint8_t kc) {
 
 // Release all keys by sending empty HID report — prevents stuck modifiers
 static void hid_release_all_keys(void) {
-    uint8_t report[8] = {0};
-    if (tud_hid_n_ready(0)) {
-        tud_hid_n_report(0, 1, report, sizeof(report));
-    }
-    // Also release consumer keys
-    uint16_t zero = 0;
-    sleep_ms(5);
-    if (tud_hid_n_ready(0)) {
-        tud_hid_n_report(0, 2, &zero, sizeof(zero));
-    }
+    keyboard_report_clear();
+    keyboard_report_send();
+    // Also release consumer keys and drop pending taps
+    consumer_report_clear();
+    consumer_report_task();
+    mouse_release_all();
+    mouse_task();
+    // Callers reboot next; push the releases out before that
+    hid_queue_flush(50);
 }
 
 // Convert special keycodes to consumer control usage codes
@@ -133,6 +136,10 @@ static bool keycode_to_consumer_usage(uint8_t code, uint16_t *usage_out) {
     switch (code) {
         case 0xB5: *usage_out = HID_USAGE_CONSUMER_SCAN_NEXT; return true;
         case 0xB6: *usage_out = HID_USAGE_CONSUMER_SCAN_PREVIOUS; return true;
+        case KC_MFFD: *usage_out = HID_USAGE_CONSUMER_FAST_FORWARD; return true;
+        case KC_MRWD: *usage_out = HID_USAGE_CONSUMER_REWIND; return true;
+        case KC_MSTP: *usage_out = HID_USAGE_CONSUMER_STOP; return true;
+        case KC_EJCT: *usage_out = HID_USAGE_CONSUMER_EJECT; return true;
         case 0xCD: *usage_out = HID_USAGE_CONSUMER_PLAY_PAUSE; return true;
         case 0x7F: *usage_out = HID_USAGE_CONSUMER_MUTE; return true;
         case 0x80: *usage_out = HID_USAGE_CONSUMER_VOLUME_INCREMENT; return true;
@@ -143,6 +150,16 @@ static bool keycode_to_consumer_usage(uint8_t code, uint16_t *usage_out) {
     }
 }
 
+// Convert system keycodes (KC_PWR/KC_SLEP/KC_WAKE) to system control usages
+static bool keycode_to_system_usage(uint8_t code, uint8_t *usage_out) {
+    switch (code) {
+        case KC_PWR:  *usage_out = SYSTEM_USAGE_POWER_DOWN; return true;
+        case KC_SLEP: *usage_out = SYSTEM_USAGE_SLEEP; return true;
+        case KC_WAKE: *usage_out = SYSTEM_USAGE_WAKE_UP; return true;
+        default: return false;
+    }
+}
+
 // Expose keymap for HID/profile modules
 uint8_t (*get_keymap_ptr(void))[SENSOR_COUNT] {
     return keymap;
@@ -200,7 +217,7 @@ static inline uint8_t compute_depth_x10(uint8_t key_idx, uint16_t adc_val) {
 // ========================================
 #define FLASH_TARGET_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)  // Last sector
 #define SETTINGS_MAGIC 0x4D494E41  // "MINA" magic number
-#define SETTINGS_VERSION 3
+#define SETTINGS_VERSION 8
 
 // Global state variables (referenced by flash storage)
 // socd_enabled is now managed by socd.h: socd_get_enabled() / socd_set_enabled()
@@ -229,9 +246,195 @@ typedef struct {
     uint16_t gradient_rotation_deg;     // 0..360
     bool socd_enabled;
     bool leds_enabled;
+    // USB MIDI output (v4+)
+    bool midi_enabled;
+    uint8_t midi_channel;
+    bool midi_aftertouch;
+    uint8_t midi_notes[SENSOR_COUNT];
+    // Two-stage keys (v5+)
+    two_stage_key_t two_stage_keys[SENSOR_COUNT];
+    uint8_t two_stage_keymap[MAX_LAYERS][SENSOR_COUNT];
+    // Per-layer actuation tables for layers 1+ (v6+), percent of baseline
+    uint8_t layer_act_mask;
+    uint8_t layer_act_pct[MAX_LAYERS - 1][SENSOR_COUNT];
+    uint8_t layer_hyst_pct[MAX_LAYERS - 1][SENSOR_COUNT];
+    // SOCD pairs (v7+)
+    uint8_t socd_global_mode;
+    socd_pair_t socd_pairs[SOCD_MAX_PAIRS];
+    // Mouse key speed curves (v8+)
+    uint16_t mouse_curves[MOUSE_CURVE_COUNT][MOUSE_CURVE_POINTS];
     uint32_t checksum;
 } settings_t;
 
+// v7 settings layout (pre-mouse keys)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint8_t keymap[MAX_LAYERS][SENSOR_COUNT];
+    uint16_t actuations[SENSOR_COUNT];  // Stored as 0.1mm units
+    uint16_t hysteresis[SENSOR_COUNT];  // Stored as 0.1mm units
+    bool adv_cal_enabled;
+    uint16_t adv_cal_release[SENSOR_COUNT];
+    uint16_t adv_cal_press[SENSOR_COUNT];
+    uint8_t led_colors[LED_COUNT * 3];  // RGB data
+    uint8_t brightness;
+    uint8_t led_effect;
+    uint8_t effect_speed;
+    uint8_t effect_direction;
+    uint8_t effect_color1[3];
+    uint8_t effect_color2[3];
+    // Gradient palette / params (used by Wave/Gradient/Radial/etc)
+    uint8_t gradient_num_colors;        // 1..8
+    uint8_t gradient_colors[8 * 3];     // RGB stops
+    uint8_t gradient_orientation;       // 0..3
+    uint16_t gradient_rotation_deg;     // 0..360
+    bool socd_enabled;
+    bool leds_enabled;
+    // USB MIDI output (v4+)
+    bool midi_enabled;
+    uint8_t midi_channel;
+    bool midi_aftertouch;
+    uint8_t midi_notes[SENSOR_COUNT];
+    // Two-stage keys (v5+)
+    two_stage_key_t two_stage_keys[SENSOR_COUNT];
+    uint8_t two_stage_keymap[MAX_LAYERS][SENSOR_COUNT];
+    // Per-layer actuation tables for layers 1+ (v6+), percent of baseline
+    uint8_t layer_act_mask;
+    uint8_t layer_act_pct[MAX_LAYERS - 1][SENSOR_COUNT];
+    uint8_t layer_hyst_pct[MAX_LAYERS - 1][SENSOR_COUNT];
+    // SOCD pairs (v7+)
+    uint8_t socd_global_mode;
+    socd_pair_t socd_pairs[SOCD_MAX_PAIRS];
+    uint32_t checksum;
+} settings_v7_t;
+
+// v6 settings layout (pre-SOCD pair persistence)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint8_t keymap[MAX_LAYERS][SENSOR_COUNT];
+    uint16_t actuations[SENSOR_COUNT];  // Stored as 0.1mm units
+    uint16_t hysteresis[SENSOR_COUNT];  // Stored as 0.1mm units
+    bool adv_cal_enabled;
+    uint16_t adv_cal_release[SENSOR_COUNT];
+    uint16_t adv_cal_press[SENSOR_COUNT];
+    uint8_t led_colors[LED_COUNT * 3];  // RGB data
+    uint8_t brightness;
+    uint8_t led_effect;
+    uint8_t effect_speed;
+    uint8_t effect_direction;
+    uint8_t effect_color1[3];
+    uint8_t effect_color2[3];
+    // Gradient palette / params (used by Wave/Gradient/Radial/etc)
+    uint8_t gradient_num_colors;        // 1..8
+    uint8_t gradient_colors[8 * 3];     // RGB stops
+    uint8_t gradient_orientation;       // 0..3
+    uint16_t gradient_rotation_deg;     // 0..360
+    bool socd_enabled;
+    bool leds_enabled;
+    // USB MIDI output (v4+)
+    bool midi_enabled;
+    uint8_t midi_channel;
+    bool midi_aftertouch;
+    uint8_t midi_notes[SENSOR_COUNT];
+    // Two-stage keys (v5+)
+    two_stage_key_t two_stage_keys[SENSOR_COUNT];
+    uint8_t two_stage_keymap[MAX_LAYERS][SENSOR_COUNT];
+    // Per-layer actuation tables for layers 1+ (v6+), percent of baseline
+    uint8_t layer_act_mask;
+    uint8_t layer_act_pct[MAX_LAYERS - 1][SENSOR_COUNT];
+    uint8_t layer_hyst_pct[MAX_LAYERS - 1][SENSOR_COUNT];
+    uint32_t checksum;
+} settings_v6_t;
+
+// v5 settings layout (pre-per-layer actuation)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint8_t keymap[MAX_LAYERS][SENSOR_COUNT];
+    uint16_t actuations[SENSOR_COUNT];  // Stored as 0.1mm units
+    uint16_t hysteresis[SENSOR_COUNT];  // Stored as 0.1mm units
+    bool adv_cal_enabled;
+    uint16_t adv_cal_release[SENSOR_COUNT];
+    uint16_t adv_cal_press[SENSOR_COUNT];
+    uint8_t led_colors[LED_COUNT * 3];  // RGB data
+    uint8_t brightness;
+    uint8_t led_effect;
+    uint8_t effect_speed;
+    uint8_t effect_direction;
+    uint8_t effect_color1[3];
+    uint8_t effect_color2[3];
+    uint8_t gradient_num_colors;        // 1..8
+    uint8_t gradient_colors[8 * 3];     // RGB stops
+    uint8_t gradient_orientation;       // 0..3
+    uint16_t gradient_rotation_deg;     // 0..360
+    bool socd_enabled;
+    bool leds_enabled;
+    bool midi_enabled;
+    uint8_t midi_channel;
+    bool midi_aftertouch;
+    uint8_t midi_notes[SENSOR_COUNT];
+    two_stage_key_t two_stage_keys[SENSOR_COUNT];
+    uint8_t two_stage_keymap[MAX_LAYERS][SENSOR_COUNT];
+    uint32_t checksum;
+} settings_v5_t;
+
+// v4 settings layout (pre-two-stage keys)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint8_t keymap[MAX_LAYERS][SENSOR_COUNT];
+    uint16_t actuations[SENSOR_COUNT];  // Stored as 0.1mm units
+    uint16_t hysteresis[SENSOR_COUNT];  // Stored as 0.1mm units
+    bool adv_cal_enabled;
+    uint16_t adv_cal_release[SENSOR_COUNT];
+    uint16_t adv_cal_press[SENSOR_COUNT];
+    uint8_t led_colors[LED_COUNT * 3];  // RGB data
+    uint8_t brightness;
+    uint8_t led_effect;
+    uint8_t effect_speed;
+    uint8_t effect_direction;
+    uint8_t effect_color1[3];
+    uint8_t effect_color2[3];
+    uint8_t gradient_num_colors;        // 1..8
+    uint8_t gradient_colors[8 * 3];     // RGB stops
+    uint8_t gradient_orientation;       // 0..3
+    uint16_t gradient_rotation_deg;     // 0..360
+    bool socd_enabled;
+    bool leds_enabled;
+    bool midi_enabled;
+    uint8_t midi_channel;
+    bool midi_aftertouch;
+    uint8_t midi_notes[SENSOR_COUNT];
+    uint32_t checksum;
+} settings_v4_t;
+
+// v3 settings layout (pre-MIDI)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint8_t keymap[MAX_LAYERS][SENSOR_COUNT];
+    uint16_t actuations[SENSOR_COUNT];  // Stored as 0.1mm units
+    uint16_t hysteresis[SENSOR_COUNT];  // Stored as 0.1mm units
+    bool adv_cal_enabled;
+    uint16_t adv_cal_release[SENSOR_COUNT];
+    uint16_t adv_cal_press[SENSOR_COUNT];
+    uint8_t led_colors[LED_COUNT * 3];  // RGB data
+    uint8_t brightness;
+    uint8_t led_effect;
+    uint8_t effect_speed;
+    uint8_t effect_direction;
+    uint8_t effect_color1[3];
+    uint8_t effect_color2[3];
+    uint8_t gradient_num_colors;        // 1..8
+    uint8_t gradient_colors[8 * 3];     // RGB stops
+    uint8_t gradient_orientation;       // 0..3
+    uint16_t gradient_rotation_deg;     // 0..360
+    bool socd_enabled;
+    bool leds_enabled;
+    uint32_t checksum;
+} settings_v3_t;
+
 // v2 settings layout (pre-gradient persistence)
 typedef struct {
     uint32_t magic;
@@ -283,6 +486,51 @@ static uint32_t calculate_checksum(const settings_t *settings) {
     return sum;
 }
 
+static uint32_t calculate_checksum_v7(const settings_v7_t *settings) {
+    const uint8_t *data = (const uint8_t *)settings;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < offsetof(settings_v7_t, checksum); i++) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+static uint32_t calculate_checksum_v6(const settings_v6_t *settings) {
+    const uint8_t *data = (const uint8_t *)settings;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < offsetof(settings_v6_t, checksum); i++) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+static uint32_t calculate_checksum_v5(const settings_v5_t *settings) {
+    const uint8_t *data = (const uint8_t *)settings;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < offsetof(settings_v5_t, checksum); i++) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+static uint32_t calculate_checksum_v4(const settings_v4_t *settings) {
+    const uint8_t *data = (const uint8_t *)settings;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < offsetof(settings_v4_t, checksum); i++) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+static uint32_t calculate_checksum_v3(const settings_v3_t *settings) {
+    const uint8_t *data = (const uint8_t *)settings;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < offsetof(settings_v3_t, checksum); i++) {
+        sum += data[i];
+    }
+    return sum;
+}
+
 static uint32_t calculate_checksum_v2(const settings_v2_t *settings) {
     const uint8_t *data = (const uint8_t *)settings;
     uint32_t sum = 0;
@@ -292,13 +540,18 @@ static uint32_t calculate_checksum_v2(const settings_v2_t *settings) {
     return sum;
 }
 
-static void save_settings_to_flash(void) {
-    settings_t settings = {0};
-    settings.magic = SETTINGS_MAGIC;
-    settings.version = SETTINGS_VERSION;
+// Staging for flash writes and host images. A settings_t is ~2 KB, too big
+// for core0's 4 KB stack on top of the main loop frame. Main loop only.
+static settings_t settings_scratch;
+
+// Serialize the live configuration into the current settings layout
+static void build_settings(settings_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->magic = SETTINGS_MAGIC;
+    out->version = SETTINGS_VERSION;
     
     // Copy current keymap
-    memcpy(settings.keymap, keymap, sizeof(keymap));
+    memcpy(out->keymap, keymap, sizeof(keymap));
     
     // Copy actuation/hysteresis (we'll need to convert from thresholds back to settings)
     // For now, just save the raw threshold values
@@ -307,45 +560,124 @@ static void save_settings_to_flash(void) {
         if (sensor_baseline[i] > 0) {
             uint32_t drop = sensor_baseline[i] - sensor_thresholds[i];
             uint32_t pct = (drop * 100) / sensor_baseline[i];
-            settings.actuations[i] = (uint16_t)pct;
+            out->actuations[i] = (uint16_t)pct;
         } else {
-            settings.actuations[i] = 16;  // Default 1.6mm
+            out->actuations[i] = 16;  // Default 1.6mm
         }
-        settings.hysteresis[i] = 13;  // Default 1.3mm (not currently tracked separately)
+        out->hysteresis[i] = 13;  // Default 1.3mm (not currently tracked separately)
     }
 
-    settings.adv_cal_enabled = adv_cal_enabled;
-    memcpy(settings.adv_cal_release, adv_cal_release, sizeof(adv_cal_release));
-    memcpy(settings.adv_cal_press, adv_cal_press, sizeof(adv_cal_press));
+    out->adv_cal_enabled = adv_cal_enabled;
+    memcpy(out->adv_cal_release, adv_cal_release, sizeof(adv_cal_release));
+    memcpy(out->adv_cal_press, adv_cal_press, sizeof(adv_cal_press));
     
     // Get LED data from lighting module
-    lighting_get_led_buffer(settings.led_colors, sizeof(settings.led_colors));
-    settings.brightness = lighting_get_brightness();
-    settings.led_effect = lighting_get_effect();
-    settings.effect_speed = lighting_get_effect_speed();
-    settings.effect_direction = lighting_get_effect_direction();
-    lighting_get_effect_color1(&settings.effect_color1[0], &settings.effect_color1[1], &settings.effect_color1[2]);
-    lighting_get_effect_color2(&settings.effect_color2[0], &settings.effect_color2[1], &settings.effect_color2[2]);
+    lighting_get_led_buffer(out->led_colors, sizeof(out->led_colors));
+    out->brightness = lighting_get_brightness();
+    out->led_effect = lighting_get_effect();
+    out->effect_speed = lighting_get_effect_speed();
+    out->effect_direction = lighting_get_effect_direction();
+    lighting_get_effect_color1(&out->effect_color1[0], &out->effect_color1[1], &out->effect_color1[2]);
+    lighting_get_effect_color2(&out->effect_color2[0], &out->effect_color2[1], &out->effect_color2[2]);
 
     // Persist gradient palette/params so Wave/Gradient restores correctly on boot.
-    lighting_get_gradient(&settings.gradient_num_colors, settings.gradient_colors, sizeof(settings.gradient_colors));
-    lighting_get_gradient_params(&settings.gradient_orientation, &settings.gradient_rotation_deg);
+    lighting_get_gradient(&out->gradient_num_colors, out->gradient_colors, sizeof(out->gradient_colors));
+    lighting_get_gradient_params(&out->gradient_orientation, &out->gradient_rotation_deg);
     
     // Store current state flags
-    settings.socd_enabled = socd_get_enabled();
-    settings.leds_enabled = leds_enabled;
-    
-    settings.checksum = calculate_checksum(&settings);
+    out->socd_enabled = socd_get_enabled();
+    out->leds_enabled = leds_enabled;
+
+    out->midi_enabled = midi_get_enabled();
+    out->midi_channel = midi_get_channel();
+    out->midi_aftertouch = midi_get_aftertouch();
+    midi_get_all_notes(out->midi_notes, SENSOR_COUNT);
+
+    two_stage_get_config(out->two_stage_keys, &out->two_stage_keymap[0][0], SENSOR_COUNT);
+
+    out->layer_act_mask = layer_actuation_get_config(&out->layer_act_pct[0][0],
+                                                         &out->layer_hyst_pct[0][0], SENSOR_COUNT);
+
+    out->socd_global_mode = socd_get_global_mode();
+    socd_get_all_pairs(out->socd_pairs);
+
+    for (uint8_t c = 0; c < MOUSE_CURVE_COUNT; c++) {
+        mouse_get_curve(c, out->mouse_curves[c]);
+    }
     
-    // Write to flash (must disable interrupts)
+    out->checksum = calculate_checksum(out);
+}
+
+static void write_settings_to_flash(const settings_t *settings) {
+    // Write to flash (must disable interrupts and park core1)
+    lighting_flash_lockout_begin();
     uint32_t ints = save_and_disable_interrupts();
     flash_range_erase(FLASH_TARGET_OFFSET, FLASH_SECTOR_SIZE);
-    flash_range_program(FLASH_TARGET_OFFSET, (const uint8_t *)&settings, sizeof(settings));
+    flash_range_program(FLASH_TARGET_OFFSET, (const uint8_t *)settings, sizeof(*settings));
     restore_interrupts(ints);
+    lighting_flash_lockout_end();
     
     printf("Settings saved to flash\n");
 }
 
+static void save_settings_to_flash(void) {
+    build_settings(&settings_scratch);
+    write_settings_to_flash(&settings_scratch);
+}
+
+// Apply the fields shared by every layout from v3 on. Later layouts only
+// append fields before the checksum, so their prefix can be read as v3.
+static void apply_settings_v3(const settings_v3_t *s) {
+    memcpy(keymap, s->keymap, sizeof(keymap));
+
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        if (sensor_baseline[i] > 0 && s->actuations[i] > 0) {
+            uint32_t thr = ((uint32_t)sensor_baseline[i] * (100 - (uint32_t)s->actuations[i])) / 100;
+            if (thr > 0xFFFF) thr = 0xFFFF;
+            sensor_thresholds[i] = (uint16_t)thr;
+        }
+    }
+
+    adv_cal_enabled = s->adv_cal_enabled;
+    memcpy(adv_cal_release, s->adv_cal_release, sizeof(adv_cal_release));
+    memcpy(adv_cal_press, s->adv_cal_press, sizeof(adv_cal_press));
+
+    lighting_set_led_buffer(s->led_colors, sizeof(s->led_colors));
+    lighting_set_max_brightness_percent(s->brightness);
+    lighting_set_effect((led_effect_t)s->led_effect);
+    lighting_set_effect_speed(s->effect_speed);
+    lighting_set_effect_direction(s->effect_direction);
+    lighting_set_effect_color1(s->effect_color1[0], s->effect_color1[1], s->effect_color1[2]);
+    lighting_set_effect_color2(s->effect_color2[0], s->effect_color2[1], s->effect_color2[2]);
+    lighting_set_gradient(s->gradient_num_colors, s->gradient_colors);
+    lighting_set_gradient_params(s->gradient_orientation, s->gradient_rotation_deg);
+
+    socd_set_enabled(s->socd_enabled);
+    leds_enabled = s->leds_enabled;
+}
+
+// Apply a settings block in the current layout
+static void apply_settings(const settings_t *s) {
+    apply_settings_v3((const settings_v3_t *)s);
+
+    midi_set_all_notes(s->midi_notes, SENSOR_COUNT);
+    midi_set_channel(s->midi_channel);
+    midi_set_aftertouch(s->midi_aftertouch);
+    midi_set_enabled(s->midi_enabled);
+
+    two_stage_set_config(s->two_stage_keys, &s->two_stage_keymap[0][0], SENSOR_COUNT);
+
+    layer_actuation_set_config(s->layer_act_mask, &s->layer_act_pct[0][0],
+                               &s->layer_hyst_pct[0][0], SENSOR_COUNT);
+
+    socd_set_global_mode(s->socd_global_mode);
+    socd_set_all_pairs(s->socd_pairs);
+
+    for (uint8_t c = 0; c < MOUSE_CURVE_COUNT; c++) {
+        mouse_set_curve(c, s->mouse_curves[c]);
+    }
+}
+
 static bool load_settings_from_flash(void) {
     const settings_t *flash_settings = (const settings_t *)(XIP_BASE + FLASH_TARGET_OFFSET);
     
@@ -436,48 +768,171 @@ static bool load_settings_from_flash(void) {
         return true;
     }
 
-    if (flash_settings->version != SETTINGS_VERSION) {
-        printf("Settings version mismatch\n");
-        return false;
+    if (flash_settings->version == 3) {
+        const settings_v3_t *v3 = (const settings_v3_t *)flash_settings;
+        uint32_t stored_checksum = v3->checksum;
+        uint32_t calculated_checksum = calculate_checksum_v3(v3);
+        if (stored_checksum != calculated_checksum) {
+            printf("Settings checksum mismatch\n");
+            return false;
+        }
+
+        apply_settings_v3(v3);
+
+        // v3 did not store MIDI settings; keep midi.c defaults (disabled).
+
+        printf("Settings loaded from flash (v3)\n");
+        return true;
     }
 
-    uint32_t stored_checksum = flash_settings->checksum;
-    uint32_t calculated_checksum = calculate_checksum(flash_settings);
-    if (stored_checksum != calculated_checksum) {
-        printf("Settings checksum mismatch\n");
-        return false;
+    if (flash_settings->version == 4) {
+        const settings_v4_t *v4 = (const settings_v4_t *)flash_settings;
+        uint32_t stored_checksum = v4->checksum;
+        uint32_t calculated_checksum = calculate_checksum_v4(v4);
+        if (stored_checksum != calculated_checksum) {
+            printf("Settings checksum mismatch\n");
+            return false;
+        }
+
+        apply_settings_v3((const settings_v3_t *)v4);
+
+        midi_set_all_notes(v4->midi_notes, SENSOR_COUNT);
+        midi_set_channel(v4->midi_channel);
+        midi_set_aftertouch(v4->midi_aftertouch);
+        midi_set_enabled(v4->midi_enabled);
+
+        // v4 did not store two-stage keys; all keys stay single-stage.
+
+        printf("Settings loaded from flash (v4)\n");
+        return true;
     }
 
-    memcpy(keymap, flash_settings->keymap, sizeof(keymap));
+    if (flash_settings->version == 5) {
+        const settings_v5_t *v5 = (const settings_v5_t *)flash_settings;
+        uint32_t stored_checksum = v5->checksum;
+        uint32_t calculated_checksum = calculate_checksum_v5(v5);
+        if (stored_checksum != calculated_checksum) {
+            printf("Settings checksum mismatch\n");
+            return false;
+        }
 
-    for (int i = 0; i < SENSOR_COUNT; i++) {
-        if (sensor_baseline[i] > 0 && flash_settings->actuations[i] > 0) {
-            uint32_t thr = ((uint32_t)sensor_baseline[i] * (100 - (uint32_t)flash_settings->actuations[i])) / 100;
-            if (thr > 0xFFFF) thr = 0xFFFF;
-            sensor_thresholds[i] = (uint16_t)thr;
+        apply_settings_v3((const settings_v3_t *)v5);
+
+        midi_set_all_notes(v5->midi_notes, SENSOR_COUNT);
+        midi_set_channel(v5->midi_channel);
+        midi_set_aftertouch(v5->midi_aftertouch);
+        midi_set_enabled(v5->midi_enabled);
+
+        two_stage_set_config(v5->two_stage_keys, &v5->two_stage_keymap[0][0], SENSOR_COUNT);
+
+        // v5 did not store per-layer actuation; every layer uses the base table.
+
+        printf("Settings loaded from flash (v5)\n");
+        return true;
+    }
+
+    if (flash_settings->version == 6) {
+        const settings_v6_t *v6 = (const settings_v6_t *)flash_settings;
+        uint32_t stored_checksum = v6->checksum;
+        uint32_t calculated_checksum = calculate_checksum_v6(v6);
+        if (stored_checksum != calculated_checksum) {
+            printf("Settings checksum mismatch\n");
+            return false;
+        }
+
+        apply_settings_v3((const settings_v3_t *)v6);
+
+        midi_set_all_notes(v6->midi_notes, SENSOR_COUNT);
+        midi_set_channel(v6->midi_channel);
+        midi_set_aftertouch(v6->midi_aftertouch);
+        midi_set_enabled(v6->midi_enabled);
+
+        two_stage_set_config(v6->two_stage_keys, &v6->two_stage_keymap[0][0], SENSOR_COUNT);
+
+        layer_actuation_set_config(v6->layer_act_mask, &v6->layer_act_pct[0][0],
+                                   &v6->layer_hyst_pct[0][0], SENSOR_COUNT);
+
+        // v6 did not store SOCD pairs; keep the socd.c defaults.
+
+        printf("Settings loaded from flash (v6)\n");
+        return true;
+    }
+
+    if (flash_settings->version == 7) {
+        const settings_v7_t *v7 = (const settings_v7_t *)flash_settings;
+        uint32_t stored_checksum = v7->checksum;
+        uint32_t calculated_checksum = calculate_checksum_v7(v7);
+        if (stored_checksum != calculated_checksum) {
+            printf("Settings checksum mismatch\n");
+            return false;
         }
+
+        apply_settings_v3((const settings_v3_t *)v7);
+
+        midi_set_all_notes(v7->midi_notes, SENSOR_COUNT);
+        midi_set_channel(v7->midi_channel);
+        midi_set_aftertouch(v7->midi_aftertouch);
+        midi_set_enabled(v7->midi_enabled);
+
+        two_stage_set_config(v7->two_stage_keys, &v7->two_stage_keymap[0][0], SENSOR_COUNT);
+
+        layer_actuation_set_config(v7->layer_act_mask, &v7->layer_act_pct[0][0],
+                                   &v7->layer_hyst_pct[0][0], SENSOR_COUNT);
+
+        socd_set_global_mode(v7->socd_global_mode);
+        socd_set_all_pairs(v7->socd_pairs);
+
+        // v7 did not store mouse curves; keep the mouse.c defaults.
+
+        printf("Settings loaded from flash (v7)\n");
+        return true;
+    }
+
+    if (flash_settings->version != SETTINGS_VERSION) {
+        printf("Settings version mismatch\n");
+        return false;
+    }
+
+    uint32_t stored_checksum = flash_settings->checksum;
+    uint32_t calculated_checksum = calculate_checksum(flash_settings);
+    if (stored_checksum != calculated_checksum) {
+        printf("Settings checksum mismatch\n");
+        return false;
     }
 
-    adv_cal_enabled = flash_settings->adv_cal_enabled;
-    memcpy(adv_cal_release, flash_settings->adv_cal_release, sizeof(adv_cal_release));
-    memcpy(adv_cal_press, flash_settings->adv_cal_press, sizeof(adv_cal_press));
+    apply_settings(flash_settings);
+
+    printf("Settings loaded from flash\n");
+    return true;
+}
 
-    lighting_set_led_buffer(flash_settings->led_colors, sizeof(flash_settings->led_colors));
-    lighting_set_max_brightness_percent(flash_settings->brightness);
-    lighting_set_effect((led_effect_t)flash_settings->led_effect);
-    lighting_set_effect_speed(flash_settings->effect_speed);
-    lighting_set_effect_direction(flash_settings->effect_direction);
-    lighting_set_effect_color1(flash_settings->effect_color1[0], flash_settings->effect_color1[1], flash_settings->effect_color1[2]);
-    lighting_set_effect_color2(flash_settings->effect_color2[0], flash_settings->effect_color2[1], flash_settings->effect_color2[2]);
+// ========================================
+// CONFIGURATION IMAGE (see config_image.h)
+// ========================================
+size_t settings_export(uint8_t *buf, size_t cap) {
+    if (cap < sizeof(settings_t)) return 0;
+    build_settings(&settings_scratch);
+    memcpy(buf, &settings_scratch, sizeof(settings_scratch));
+    return sizeof(settings_scratch);
+}
 
-    // Restore gradient palette/params (v3+)
-    lighting_set_gradient(flash_settings->gradient_num_colors, flash_settings->gradient_colors);
-    lighting_set_gradient_params(flash_settings->gradient_orientation, flash_settings->gradient_rotation_deg);
+// Validate, apply and persist a settings block from a host image. Only the
+// current layout is accepted: the host app reads the image from this
+// firmware before editing it.
+bool settings_block_valid(const uint8_t *buf, size_t len) {
+    if (len != sizeof(settings_t)) return false;
+    memcpy(&settings_scratch, buf, sizeof(settings_scratch));
+    if (settings_scratch.magic != SETTINGS_MAGIC || settings_scratch.version != SETTINGS_VERSION) return false;
+    return settings_scratch.checksum == calculate_checksum(&settings_scratch);
+}
 
-    socd_set_enabled(flash_settings->socd_enabled);
-    leds_enabled = flash_settings->leds_enabled;
+bool settings_import(const uint8_t *buf, size_t len) {
+    // Leaves the block in settings_scratch
+    if (!settings_block_valid(buf, len)) return false;
 
-    printf("Settings loaded from flash\n");
+    apply_settings(&settings_scratch);
+    layer_actuation_recompute();
+    write_settings_to_flash(&settings_scratch);
     return true;
 }
 
@@ -521,6 +976,14 @@ static const uint8_t mux_to_adc[MUX_COUNT] = {
 #define MUX_SETTLE_US 200u
 #define SCAN_DELAY_MS 5u
 
+// The pause between scans is skipped while something has to be serviced
+// every USB frame: mouse movement is reported at 1 ms, SOF alignment paces
+// the loop itself (one scan per frame, finished just before the SOF), and an
+// ADC snapshot stream captures a new frame as soon as the last one is out.
+static bool scan_delay_allowed(void) {
+    return !mouse_active() && !sof_align_active() && !adc_snapshot_streaming();
+}
+
 static uint16_t mcp3208_read(uint8_t ch) {
     uint8_t tx[3];
     uint8_t rx[3];
@@ -555,15 +1018,16 @@ static uint16_t sample_adc_avg_for_adc(uint8_t adc_ch)
 }
 
 // LED gate helper: drive LED gate pin according to configured polarity.
+// Lighting output follows it; off sends a black frame, which is all that
+// turns the LEDs off on boards without LED_GATE_PIN.
 static inline void led_power_set(bool on) {
+    lighting_set_output_enabled(on);
 #ifdef LED_GATE_PIN
   #if LED_GATE_ACTIVE_LOW
     gpio_put(LED_GATE_PIN, on ? 0 : 1);
   #else
     gpio_put(LED_GATE_PIN, on ? 1 : 0);
   #endif
-#else
-    (void)on;
 #endif
 }
 
@@ -617,6 +1081,107 @@ void mcp3208_hallscan_calibrate(void)
             sensor_thresholds[sidx] = (uint16_t)thr;
         }
     }
+
+    // Deep-stage and per-layer thresholds are relative to the new baselines
+    two_stage_recompute_thresholds();
+    layer_actuation_recompute();
+}
+
+// ========== USB SUSPEND ==========
+// While the host is suspended the LEDs are gated off and the keys are only
+// sampled every SUSPEND_SCAN_INTERVAL_MS to look for a wake press. The
+// callbacks run from tud_task() in the main loop.
+static bool usb_suspended = false;
+static bool usb_remote_wakeup_en = false;
+static bool wake_ref_valid = false;
+static uint8_t wake_ref_depth[SENSOR_COUNT];
+
+static void usb_power_resume(void)
+{
+    if (!usb_suspended) return;
+    usb_suspended = false;
+    led_power_set(leds_enabled);
+}
+
+void tud_suspend_cb(bool remote_wakeup_en)
+{
+    usb_suspended = true;
+    usb_remote_wakeup_en = remote_wakeup_en;
+    wake_ref_valid = false;
+    // Dark for the whole suspend: gated off, or blanked where there is no gate.
+    // Resume re-enables output and the current effect is drawn again.
+    led_power_set(false);
+}
+
+void tud_resume_cb(void)
+{
+    usb_power_resume();
+}
+
+// Host (re)configured the device: a new host session starts, so formats
+// negotiated by the previous one no longer apply
+void tud_mount_cb(void)
+{
+    // A bus reset ends a suspend without a resume event
+    usb_power_resume();
+    hid_reset_host_protocol();
+    notify_reset();
+}
+
+// One low-rate pass over the keys while suspended. The first pass records
+// the resting depth of every key; a later pass that finds any key moved by
+// SUSPEND_WAKE_DEPTH_X10 signals remote wakeup and re-arms from there.
+static void suspend_wake_scan(void)
+{
+    const mux16_ref_t *mux_maps_local[MUX_COUNT] = {
+        mux1_channels,
+        mux2_channels,
+#if MUX_COUNT >= 3
+        mux3_channels,
+#endif
+#if MUX_COUNT >= 4
+        mux4_channels,
+#endif
+#if MUX_COUNT >= 5
+        mux5_channels,
+#endif
+#if MUX_COUNT >= 6
+        mux6_channels,
+#endif
+#if MUX_COUNT >= 7
+        mux7_channels,
+#endif
+#if MUX_COUNT >= 8
+        mux8_channels,
+#endif
+    };
+
+    bool moved = false;
+    for (uint8_t sel = 0; sel < 16; sel++) {
+        mux_set(sel);
+        sleep_us(MUX_SETTLE_US);
+        for (uint8_t m = 0; m < MUX_COUNT; m++) {
+            sensor_id_t sid = mux_maps_local[m][sel].sensor;
+            if (sid == 0 || sid > SENSOR_COUNT) continue;
+            const uint8_t sidx = (uint8_t)(sid - 1);
+            const uint8_t depth = compute_depth_x10(sidx, mcp3208_read(mux_to_adc[m]));
+            if (!wake_ref_valid) {
+                wake_ref_depth[sidx] = depth;
+                continue;
+            }
+            const int diff = (int)depth - (int)wake_ref_depth[sidx];
+            if (diff >= SUSPEND_WAKE_DEPTH_X10 || diff <= -SUSPEND_WAKE_DEPTH_X10) moved = true;
+        }
+    }
+
+    if (!wake_ref_valid) {
+        wake_ref_valid = true;
+        return;
+    }
+    if (moved) {
+        tud_remote_wakeup();
+        wake_ref_valid = false;
+    }
 }
 
 uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen)
@@ -666,6 +1231,333 @@ void tud_hid_report_received_cb(uint8_t instance, uint8_t const* report, uint16_
     }
 }
 
+// ========================================
+// KEY EVENTS -> HID REPORTS
+// ========================================
+// Keycode each key emitted at press time, so a release removes exactly what
+// its press added even if the layer changed in between.
+static uint8_t key_usage[SENSOR_COUNT];       // primary stage (0 = none)
+static uint8_t key_deep_usage[SENSOR_COUNT];  // deep stage (0 = none)
+static bool key_usage_suppressed[SENSOR_COUNT];  // primary released by a REPLACE deep stage
+
+static void usage_press(uint8_t kc) {
+    uint8_t system = 0;
+    if (keycode_to_system_usage(kc, &system)) {
+        consumer_report_system_press(system);
+        return;
+    }
+    uint16_t usage = 0;
+    if (keycode_to_consumer_usage(kc, &usage)) {
+        consumer_report_press(usage);
+        return;
+    }
+    keyboard_report_press(kc);
+}
+
+static void usage_release(uint8_t kc) {
+    uint8_t system = 0;
+    if (keycode_to_system_usage(kc, &system)) {
+        consumer_report_system_release(system);
+        return;
+    }
+    uint16_t usage = 0;
+    if (keycode_to_consumer_usage(kc, &usage)) {
+        consumer_report_release(usage);
+        return;
+    }
+    keyboard_report_release(kc);
+}
+
+static inline bool is_custom_keycode(uint8_t kc) {
+    return kc == KC_BOOTLOADER || kc == KC_REBOOT || kc == KC_CALIBRATE ||
+           kc == KC_LED_TOG || kc == KC_SOCD_TOG;
+}
+
+static void run_custom_keycode(uint8_t kc) {
+    if (kc == KC_BOOTLOADER) {
+        printf("Keycode: entering bootloader...\n");
+        hid_release_all_keys();
+        sleep_ms(150);
+        led_power_set(false);
+        sleep_ms(50);
+        reset_usb_boot(0, 0);
+    }
+    if (kc == KC_REBOOT) {
+        printf("Keycode: rebooting...\n");
+        hid_release_all_keys();
+        sleep_ms(150);
+        led_power_set(false);
+        sleep_ms(50);
+        watchdog_reboot(0, 0, 100);
+    }
+    if (kc == KC_CALIBRATE) {
+        printf("Keycode: recalibrating...\n");
+        mcp3208_hallscan_calibrate();
+    }
+    if (kc == KC_LED_TOG) {
+        leds_enabled = !leds_enabled;
+        led_power_set(leds_enabled);
+        printf("Keycode: LED toggle -> %s\n", leds_enabled ? "ON" : "OFF");
+    }
+    if (kc == KC_SOCD_TOG) {
+        socd_toggle();
+        lighting_socd_animation(socd_get_enabled());
+        printf("Keycode: SOCD toggle -> %s\n", socd_get_enabled() ? "ON" : "OFF");
+    }
+}
+
+// Primary stage press/release
+static void key_primary_event(uint8_t idx, bool pressed, uint8_t layer) {
+    if (!pressed) {
+        if (mouse_is_keycode(key_usage[idx])) mouse_key_event(idx, key_usage[idx], false);
+        else if (key_usage[idx] != 0 && !key_usage_suppressed[idx]) usage_release(key_usage[idx]);
+        key_usage[idx] = 0;
+        key_usage_suppressed[idx] = false;
+        return;
+    }
+
+    // Keys routed to MIDI never reach the keyboard report
+    if (midi_key_claimed(idx)) return;
+
+    const uint8_t kc = get_keycode(layer, idx);
+    // MO/TG layer keys are handled by the layer section of the scan loop
+    if (kc == 0 || is_mo_keycode(kc) || is_tg_keycode(kc)) return;
+
+    // Custom keycodes act on press and never reach the report
+    if (is_custom_keycode(kc)) {
+        run_custom_keycode(kc);
+        return;
+    }
+
+    key_usage[idx] = kc;
+    key_usage_suppressed[idx] = false;
+    // Mouse keys need the key index: their speed follows its depth
+    if (mouse_is_keycode(kc)) {
+        mouse_key_event(idx, kc, true);
+        return;
+    }
+    usage_press(kc);
+}
+
+// Deep stage (two-stage keys): modifiers, consumer and regular keys only
+static void key_deep_event(uint8_t idx, bool active, uint8_t layer) {
+    if (!active) {
+        if (key_deep_usage[idx] != 0) usage_release(key_deep_usage[idx]);
+        key_deep_usage[idx] = 0;
+        if (key_usage_suppressed[idx]) {
+            key_usage_suppressed[idx] = false;
+            usage_press(key_usage[idx]);
+        }
+        return;
+    }
+
+    if (midi_key_claimed(idx)) return;
+
+    const uint8_t kc = two_stage_get_keycode(layer, idx);
+    if (kc == 0 || is_mo_keycode(kc) || is_tg_keycode(kc) || is_custom_keycode(kc) ||
+        mouse_is_keycode(kc)) return;
+    // A REPLACE deep stage cannot stand in for a mouse key
+    if (mouse_is_keycode(key_usage[idx])) return;
+
+    key_deep_usage[idx] = kc;
+    usage_press(kc);
+
+    if (two_stage_get_mode(idx) == TWO_STAGE_MODE_REPLACE && key_usage[idx] != 0) {
+        usage_release(key_usage[idx]);
+        key_usage_suppressed[idx] = true;
+    }
+}
+
+// ========================================
+// RAW HID COMMAND DISPATCH
+// ========================================
+// Current active layer (0 = base, 1 = Fn layer, 2-3 = extra layers)
+// Fn key (S_FN) acts as MO(1) - momentary layer 1
+static uint8_t current_layer = 0;
+
+// Debounced flash save for settings changes
+static bool pending_settings_save = false;
+static uint32_t last_settings_change_ms = 0;
+
+typedef void (*hid_cmd_handler_t)(const hid_cmd_t *cmd);
+
+// GP23 (LED_GATE_PIN) toggle is controlled via HID from software
+static void cmd_led_power_toggle(const hid_cmd_t *cmd) {
+    leds_enabled = !leds_enabled;
+    led_power_set(leds_enabled);
+    printf("HID: LED gate toggled: %s\n", leds_enabled ? "ENABLED" : "DISABLED");
+}
+
+static void cmd_led_power_set(const hid_cmd_t *cmd) {
+    leds_enabled = (cmd->u8 != 0);
+    led_power_set(leds_enabled);
+    printf("HID: LED gate set: %s\n", leds_enabled ? "ENABLED" : "DISABLED");
+}
+
+static void cmd_socd_toggle(const hid_cmd_t *cmd) {
+    socd_toggle();
+    bool socd_now = socd_get_enabled();
+    lighting_socd_animation(socd_now);
+    printf("HID: SOCD toggled: %s\n", socd_now ? "ENABLED" : "DISABLED");
+}
+
+static void cmd_socd_set(const hid_cmd_t *cmd) {
+    socd_set_enabled(cmd->u8 != 0);
+    bool socd_now = socd_get_enabled();
+    lighting_socd_animation(socd_now);
+    printf("HID: SOCD set: %s\n", socd_now ? "ENABLED" : "DISABLED");
+}
+
+static void cmd_brightness_set(const hid_cmd_t *cmd) {
+    lighting_set_max_brightness_percent(cmd->u8);
+    printf("HID: Brightness set to %d%%\n", cmd->u8);
+}
+
+static void cmd_actuation_set(const hid_cmd_t *cmd) {
+    const uint8_t key_idx = cmd->actuation.key_idx;
+    const uint8_t percent = cmd->actuation.percent;
+    if (key_idx >= SENSOR_COUNT) return;
+    // Compute new threshold from baseline
+    uint32_t thr = ((uint32_t)sensor_baseline[key_idx] * (100 - (uint32_t)percent)) / 100;
+    if (thr > 0xFFFF) thr = 0xFFFF;
+    sensor_thresholds[key_idx] = (uint16_t)thr;
+    layer_actuation_recompute();
+    printf("HID: Key %d actuation set to %d%%\n", key_idx, percent);
+}
+
+static void cmd_layer_set(const hid_cmd_t *cmd) {
+    current_layer = cmd->u8;
+    lighting_set_active_layer(current_layer);
+    printf("HID: Layer set to %d\n", current_layer);
+}
+
+static void cmd_keymap_set(const hid_cmd_t *cmd) {
+    const uint8_t layer = cmd->keymap.layer;
+    const uint8_t key_idx = cmd->keymap.key_idx;
+    if (layer >= MAX_LAYERS || key_idx >= SENSOR_COUNT) return;
+    keymap[layer][key_idx] = cmd->keymap.keycode;
+    printf("HID: Keymap updated - Layer %d, Key %d = 0x%02X\n", layer, key_idx, cmd->keymap.keycode);
+    // Debounced save will be triggered by settings_changed flag
+}
+
+static void cmd_calibrate(const hid_cmd_t *cmd) {
+    printf("HID: Recalibrating sensors...\n");
+    mcp3208_hallscan_calibrate();
+    printf("HID: Calibration complete\n");
+}
+
+static void cmd_bootloader(const hid_cmd_t *cmd) {
+    printf("HID: Rebooting to bootloader...\n");
+    hid_release_all_keys();
+    sleep_ms(150);
+    led_power_set(false);
+    sleep_ms(50);
+    reset_usb_boot(0, 0);
+}
+
+static void cmd_save_settings(const hid_cmd_t *cmd) {
+    printf("HID: Saving profile to flash...\n");
+    save_settings_to_flash();
+    pending_settings_save = false;
+}
+
+static void cmd_load_settings(const hid_cmd_t *cmd) {
+    printf("HID: Loading profile from flash...\n");
+    load_settings_from_flash();
+}
+
+static void cmd_profile_save(const hid_cmd_t *cmd) {
+    uint8_t r = 0, g = 0, b = 0;
+    profiles_get_slot_color(cmd->u8, &r, &g, &b);
+    profiles_save_slot(cmd->u8, r, g, b, profiles_static_indicator_enabled());
+}
+
+static void cmd_profile_load(const hid_cmd_t *cmd) {
+    profiles_load_slot(cmd->u8);
+}
+
+static void cmd_profile_delete(const hid_cmd_t *cmd) {
+    profiles_delete_slot(cmd->u8);
+}
+
+static void cmd_profile_blank(const hid_cmd_t *cmd) {
+    profiles_create_blank_slot(cmd->u8);
+}
+
+static void cmd_adc_stream_enable(const hid_cmd_t *cmd) {
+    adc_streaming_enabled = (cmd->u8 != 0);
+    printf("HID: ADC streaming %s\n", adc_streaming_enabled ? "enabled" : "disabled");
+}
+
+// Single key ADC request (for live preview)
+static void cmd_get_key_adc(const hid_cmd_t *cmd) {
+    adc_stream_key_idx = cmd->u8;
+    adc_stream_key_pending = true;
+}
+
+static void cmd_adv_cal_enable(const hid_cmd_t *cmd) {
+    adv_cal_enabled = (cmd->u8 != 0);
+}
+
+static void cmd_adv_cal_set_key(const hid_cmd_t *cmd) {
+    const uint8_t key_idx = cmd->adv_cal.key_idx;
+    if (key_idx >= SENSOR_COUNT) return;
+    adv_cal_release[key_idx] = cmd->adv_cal.release_adc;
+    adv_cal_press[key_idx] = cmd->adv_cal.press_adc;
+}
+
+static void cmd_adv_cal_get_key(const hid_cmd_t *cmd) {
+    const uint8_t key_idx = cmd->u8;
+    uint16_t rel = 0, prs = 0;
+    if (key_idx < SENSOR_COUNT) {
+        rel = adv_cal_release[key_idx];
+        prs = adv_cal_press[key_idx];
+    }
+    hid_send_adv_calibration(key_idx, adv_cal_enabled, rel, prs);
+}
+
+static void cmd_config_commit(const hid_cmd_t *cmd) {
+    const config_status_t st = config_image_commit();
+    // The image was written to flash as a whole; nothing left to debounce
+    if (st == CONFIG_STATUS_OK) pending_settings_save = false;
+    hid_send_config_status(cmd->instance, CMD_CONFIG_WRITE_COMMIT, st);
+}
+
+static const hid_cmd_handler_t hid_cmd_handlers[HID_CMD_TYPE_COUNT] = {
+    [HID_CMD_LED_POWER_TOGGLE]  = cmd_led_power_toggle,
+    [HID_CMD_LED_POWER_SET]     = cmd_led_power_set,
+    [HID_CMD_SOCD_TOGGLE]       = cmd_socd_toggle,
+    [HID_CMD_SOCD_SET]          = cmd_socd_set,
+    [HID_CMD_BRIGHTNESS_SET]    = cmd_brightness_set,
+    [HID_CMD_ACTUATION_SET]     = cmd_actuation_set,
+    [HID_CMD_LAYER_SET]         = cmd_layer_set,
+    [HID_CMD_KEYMAP_SET]        = cmd_keymap_set,
+    [HID_CMD_CALIBRATE]         = cmd_calibrate,
+    [HID_CMD_BOOTLOADER]        = cmd_bootloader,
+    [HID_CMD_SAVE_SETTINGS]     = cmd_save_settings,
+    [HID_CMD_LOAD_SETTINGS]     = cmd_load_settings,
+    [HID_CMD_PROFILE_SAVE]      = cmd_profile_save,
+    [HID_CMD_PROFILE_LOAD]      = cmd_profile_load,
+    [HID_CMD_PROFILE_DELETE]    = cmd_profile_delete,
+    [HID_CMD_PROFILE_BLANK]     = cmd_profile_blank,
+    [HID_CMD_ADC_STREAM_ENABLE] = cmd_adc_stream_enable,
+    [HID_CMD_GET_KEY_ADC]       = cmd_get_key_adc,
+    [HID_CMD_ADV_CAL_ENABLE]    = cmd_adv_cal_enable,
+    [HID_CMD_ADV_CAL_SET_KEY]   = cmd_adv_cal_set_key,
+    [HID_CMD_ADV_CAL_GET_KEY]   = cmd_adv_cal_get_key,
+    [HID_CMD_CONFIG_COMMIT]     = cmd_config_commit,
+};
+
+// Apply every queued command in arrival order
+static void hid_cmd_dispatch(void) {
+    hid_cmd_t cmd;
+    while (hid_cmd_pop(&cmd)) {
+        if (cmd.type < HID_CMD_TYPE_COUNT && hid_cmd_handlers[cmd.type]) {
+            hid_cmd_handlers[cmd.type](&cmd);
+        }
+    }
+}
+
 int main() {
     // Initialize stdio - but don't block if no USB
     stdio_init_all();
@@ -674,7 +1566,15 @@ int main() {
     printf("main_firmware: starting v1.0\n");
 
     // Initialize USB
+    hid_queue_init();
+    hid_cmd_init();
+    raw_tx_init();
+    config_image_init();
+    latency_init();
+    notify_init();
+    consumer_report_init();
     tusb_init();
+    sof_align_init();
 
     // Initialize LED gate (controls 5V LED power rail)
 #ifdef LED_GATE_PIN
@@ -743,13 +1643,14 @@ int main() {
     // GP23 (LED_GATE_PIN) is controlled via HID commands from software
     // leds_enabled is a global variable; SOCD state managed by socd.h API
     
-    // Current active layer (0 = base, 1 = Fn layer, 2-3 = extra layers)
-    // Fn key (S_FN) acts as MO(1) - momentary layer 1
-    uint8_t current_layer = 0;
-
     // Initialize SOCD and encoder modules
     socd_init();
     encoder_init();
+    midi_init();
+    two_stage_init();
+    layer_actuation_init();
+    mouse_init();
+    adc_snapshot_init();
     
     // Skip startup animation - just initialize LEDs to off
     // (Startup animation was causing issues with lighting state)
@@ -762,21 +1663,19 @@ int main() {
     if (!load_settings_from_flash()) {
         printf("Using default settings\n");
     }
+    // Base actuation table follows the (possibly restored) sensor_thresholds
+    layer_actuation_recompute();
     
     // Sync LED power gate with loaded settings
     led_power_set(leds_enabled);
     
-    // Apply the saved effect immediately so LEDs light up on startup
-    if (leds_enabled) {
-        lighting_update();
-    }
+    // Frames run on core1 from here; the saved effect shows right away
+    lighting_start();
 
     // Initialize modern profile storage (separate flash sector)
     profiles_init();
 
     // Debounced flash save for settings changes.
-    bool pending_settings_save = false;
-    uint32_t last_settings_change_ms = 0;
     const uint32_t SETTINGS_SAVE_DEBOUNCE_MS = 350;
 
     while (true) {
@@ -791,6 +1690,20 @@ int main() {
             }
         }
 
+        // Suspended: no scan, reports or lighting. Wake checks run at a low
+        // rate, but tud_task() still runs every millisecond so a resume is
+        // back to full-rate scanning on the next pass.
+        if (usb_suspended) {
+            static uint32_t last_wake_scan_ms = 0;
+            const uint32_t now_ms = to_ms_since_boot(get_absolute_time());
+            if (usb_remote_wakeup_en && (now_ms - last_wake_scan_ms) >= SUSPEND_SCAN_INTERVAL_MS) {
+                last_wake_scan_ms = now_ms;
+                suspend_wake_scan();
+            }
+            sleep_ms(1);
+            continue;
+        }
+
         // ========== ENCODER HANDLING ==========
         // Accumulate quadrature edges and emit on a full detent.
         // Most encoders produce 2 or 4 edges per detent; 2 is the common default.
@@ -809,221 +1722,71 @@ int main() {
         }
 
         // Emit one consumer tap per detent
-        while ((accumulated_steps >= DETENT_STEPS || accumulated_steps <= -DETENT_STEPS) && tud_hid_n_ready(0)) {
+        // Taps are queued; consumer_report_task() times press and release
+        while (accumulated_steps >= DETENT_STEPS || accumulated_steps <= -DETENT_STEPS) {
             uint16_t consumer_code = (accumulated_steps > 0)
                 ? HID_USAGE_CONSUMER_VOLUME_INCREMENT
                 : HID_USAGE_CONSUMER_VOLUME_DECREMENT;
 
-            tud_hid_n_report(0, 2, &consumer_code, sizeof(consumer_code));
-            sleep_ms(5);
-            consumer_code = 0;
-            tud_hid_n_report(0, 2, &consumer_code, sizeof(consumer_code));
+            if (!consumer_report_tap(consumer_code)) break;  // tap queue full, keep the steps
 
             accumulated_steps += (accumulated_steps > 0) ? -DETENT_STEPS : DETENT_STEPS;
         }
         
         if (encoder_switch_pressed()) {
             printf("Encoder switch pressed\n");
-            if (tud_hid_n_ready(0)) {
-                // Mute using consumer control
-                uint16_t consumer_code = HID_USAGE_CONSUMER_MUTE;
-                tud_hid_n_report(0, 2, &consumer_code, sizeof(consumer_code));
-                sleep_ms(10);
-                consumer_code = 0;
-                tud_hid_n_report(0, 2, &consumer_code, sizeof(consumer_code));
-            }
+            // Mute using consumer control
+            consumer_report_tap(HID_USAGE_CONSUMER_MUTE);
         }
 
         // ========== HID COMMAND HANDLING ==========
-        // GP23 (LED_GATE_PIN) toggle is controlled via HID from software
-        // Handle LED power toggle from HID
-        if (hid_consume_led_power_toggle()) {
-            leds_enabled = !leds_enabled;
-            led_power_set(leds_enabled);
-            printf("HID: LED gate toggled: %s\n", leds_enabled ? "ENABLED" : "DISABLED");
-        }
-        
-        // Handle LED power set from HID
-        int led_pwr_set = hid_consume_led_power_set();
-        if (led_pwr_set >= 0) {
-            leds_enabled = (led_pwr_set != 0);
-            led_power_set(leds_enabled);
-            printf("HID: LED gate set: %s\n", leds_enabled ? "ENABLED" : "DISABLED");
-        }
-        
-        // Handle SOCD toggle from HID
-        if (hid_consume_socd_toggle()) {
-            socd_toggle();
-            bool socd_now = socd_get_enabled();
-            lighting_socd_animation(socd_now);
-            printf("HID: SOCD toggled: %s\n", socd_now ? "ENABLED" : "DISABLED");
-        }
+        hid_cmd_dispatch();
 
-        // Handle SOCD set from HID
-        int socd_set = hid_consume_socd_set();
-        if (socd_set >= 0) {
-            socd_set_enabled(socd_set != 0);
-            bool socd_now = socd_get_enabled();
-            lighting_socd_animation(socd_now);
-            printf("HID: SOCD set: %s\n", socd_now ? "ENABLED" : "DISABLED");
-        }
-        
-        // Handle brightness set from HID
-        int brightness_val = hid_consume_brightness_set();
-        if (brightness_val >= 0) {
-            lighting_set_max_brightness_percent((uint8_t)brightness_val);
-            printf("HID: Brightness set to %d%%\n", brightness_val);
-        }
-        
-        // Handle per-key actuation set from HID
-        uint8_t act_key_idx, act_threshold;
-        if (hid_consume_actuation_set(&act_key_idx, &act_threshold)) {
-            if (act_key_idx < SENSOR_COUNT) {
-                // Compute new threshold from baseline
-                uint32_t thr = ((uint32_t)sensor_baseline[act_key_idx] * (100 - (uint32_t)act_threshold)) / 100;
-                if (thr > 0xFFFF) thr = 0xFFFF;
-                sensor_thresholds[act_key_idx] = (uint16_t)thr;
-                printf("HID: Key %d actuation set to %d%%\n", act_key_idx, act_threshold);
-            }
-        }
-        
-        // Handle layer change from HID
-        int new_layer = hid_consume_layer_set();
-        if (new_layer >= 0) {
-            current_layer = (uint8_t)new_layer;
-            lighting_set_active_layer(current_layer);
-            printf("HID: Layer set to %d\n", new_layer);
-        }
-        
-        // Handle keymap change from HID (individual key)
-        uint8_t km_layer, km_key_idx, km_hid_keycode;
-        if (hid_consume_keymap_set(&km_layer, &km_key_idx, &km_hid_keycode)) {
-            if (km_layer < MAX_LAYERS && km_key_idx < SENSOR_COUNT) {
-                keymap[km_layer][km_key_idx] = km_hid_keycode;
-                printf("HID: Keymap updated - Layer %d, Key %d = 0x%02X\n", km_layer, km_key_idx, km_hid_keycode);
-                // Debounced save will be triggered by settings_changed flag
-            }
-        }
-        
         // Handle bulk keymap/settings changes - save to flash
         if (hid_consume_settings_changed()) {
             pending_settings_save = true;
             last_settings_change_ms = to_ms_since_boot(get_absolute_time());
         }
-        
-        // Handle calibration request from HID
-        if (hid_consume_calibrate()) {
-            printf("HID: Recalibrating sensors...\n");
-            mcp3208_hallscan_calibrate();
-            printf("HID: Calibration complete\n");
-        }
-        
-        // Handle bootloader request from HID
-        if (hid_consume_bootloader()) {
-            printf("HID: Rebooting to bootloader...\n");
-            hid_release_all_keys();
-            sleep_ms(150);
-            led_power_set(false);
-            sleep_ms(50);
-            reset_usb_boot(0, 0);
-        }
-        
-        // Handle save profile request from HID
-        if (hid_consume_save_profile()) {
-            printf("HID: Saving profile to flash...\n");
-            save_settings_to_flash();
-            pending_settings_save = false;
-        }
-        
-        // Handle load profile request from HID
-        if (hid_consume_load_profile()) {
-            printf("HID: Loading profile from flash...\n");
-            load_settings_from_flash();
-        }
-
-        // Handle ADC streaming enable/disable
-        bool adc_stream_req;
-        if (hid_consume_adc_stream_enable(&adc_stream_req)) {
-            adc_streaming_enabled = adc_stream_req;
-            printf("HID: ADC streaming %s\n", adc_streaming_enabled ? "enabled" : "disabled");
-        }
-
-        // Advanced calibration enable
-        bool adv_en;
-        if (hid_consume_set_adv_cal_enabled(&adv_en)) {
-            adv_cal_enabled = adv_en;
-        }
-
-        // Advanced calibration set key
-        uint8_t cal_key = 0;
-        uint16_t cal_rel = 0, cal_prs = 0;
-        if (hid_consume_set_adv_cal_key(&cal_key, &cal_rel, &cal_prs)) {
-            if (cal_key < SENSOR_COUNT) {
-                adv_cal_release[cal_key] = cal_rel;
-                adv_cal_press[cal_key] = cal_prs;
-            }
-        }
-
-        // Advanced calibration get key
-        uint8_t get_cal_key = 0;
-        if (hid_consume_get_adv_cal_key(&get_cal_key)) {
-            uint16_t rel = 0, prs = 0;
-            if (get_cal_key < SENSOR_COUNT) {
-                rel = adv_cal_release[get_cal_key];
-                prs = adv_cal_press[get_cal_key];
-            }
-            hid_send_adv_calibration(get_cal_key, adv_cal_enabled, rel, prs);
-        }
-
-        // Handle single key ADC request (for live preview)
-        uint8_t adc_key_idx;
-        if (hid_consume_get_key_adc(&adc_key_idx)) {
-            adc_stream_key_idx = adc_key_idx;
-            adc_stream_key_pending = true;
-        }
-
-        // Modern profile commands (0x70+)
-        uint8_t slot = 0;
-        if (hid_consume_profile_save(&slot)) {
-            uint8_t r = 0, g = 0, b = 0;
-            profiles_get_slot_color(slot, &r, &g, &b);
-            profiles_save_slot(slot, r, g, b, profiles_static_indicator_enabled());
-        }
-        if (hid_consume_profile_load(&slot)) {
-            profiles_load_slot(slot);
-        }
-        if (hid_consume_profile_delete(&slot)) {
-            profiles_delete_slot(slot);
-        }
-        if (hid_consume_profile_blank(&slot)) {
-            profiles_create_blank_slot(slot);
-        }
 
         profiles_task();
+        midi_task();
+        hid_queue_task();
+        raw_tx_task();
         
         // GP20 state handling removed - LEDs always stay on unless controlled by software
 
         // Check for LED updates queued by HID handler and apply from
         // main loop context (safe to call PIO functions here).
-        uint8_t ledbuf[LED_COUNT * 3];
+        // Buffers in this loop are static: core0 has a 4 KB stack and the
+        // HID/flash paths below it need most of that
+        static uint8_t ledbuf[LED_COUNT * 3];
         if (hid_consume_led_update(ledbuf, sizeof(ledbuf))) {
             // Apply LED buffer for paint mode / per-key color updates
             lighting_set_led_buffer(ledbuf, sizeof(ledbuf));
         }
 
+        // Hold off the scan so its report is queued just before the next SOF
+        sof_align_wait();
+
         static bool prev_pressed[SENSOR_COUNT + 1] = {0};
         bool cur_pressed[SENSOR_COUNT + 1];
         for (int i = 0; i <= SENSOR_COUNT; i++) cur_pressed[i] = false;
-        char outbuf[2048];
+        // Second (deep) actuation stage, same indexing as cur_pressed
+        static bool prev_deep[SENSOR_COUNT + 1] = {0};
+        bool cur_deep[SENSOR_COUNT + 1];
+        for (int i = 0; i <= SENSOR_COUNT; i++) cur_deep[i] = false;
+        static char outbuf[2048];
         size_t off = 0;
         size_t left = sizeof(outbuf);
 
-        uint16_t mux_vals[MUX_COUNT][16];
+        static uint16_t mux_vals[MUX_COUNT][16];
+        uint32_t mux_time_us[16];  // sample time per select line (MIDI velocity timing)
         for (uint8_t i = 0; i < MUX_COUNT; i++) for (int s = 0; s < 16; s++) mux_vals[i][s] = 0;
 
         for (uint8_t sel = 0; sel < 16; sel++) {
             mux_set(sel);
             sleep_us(MUX_SETTLE_US);
+            mux_time_us[sel] = time_us_32();
             // Read all 5 MUX channels
             for (uint8_t m = 0; m < MUX_COUNT; m++) {
                 mux_vals[m][sel] = mcp3208_read(mux_to_adc[m]);
@@ -1052,21 +1815,31 @@ int main() {
             mux8_channels,
 #endif
         };
+        // Actuation table for the active layer (pointer swap, no per-key math)
+        const layer_actuation_table_t *act_table = layer_actuation_select(current_layer);
+
         for (uint8_t m = 0; m < MUX_COUNT; m++) {
             for (uint8_t s = 0; s < 16; s++) {
                 sensor_id_t sid = mux_maps[m][s].sensor;
                 if (sid != 0) {
                     uint8_t sidx = (uint8_t)(sid - 1);
-                    uint16_t thr = sensor_thresholds[sidx];
+                    uint16_t thr = act_table->press[sidx];
                     uint16_t val = mux_vals[m][s];
                     
                     // Cache ADC value for streaming
                     adc_cached_values[sidx] = val;
                     
                     if (thr == 0) continue;
-                    // Hysteresis: compute release threshold as thr + baseline * HYST_PERCENT/100
-                    uint32_t delta = ((uint32_t)sensor_baseline[sidx] * (uint32_t)HALLSCAN_HYSTERESIS_PERCENT) / 100;
-                    uint32_t release_thr = (uint32_t)thr + delta;
+
+                    if (midi_get_enabled()) {
+                        midi_process_key(sidx, compute_depth_x10(sidx, val),
+                                         compute_depth_x10(sidx, thr), mux_time_us[s]);
+                    }
+                    if (mouse_key_held(sidx)) {
+                        mouse_key_depth(sidx, compute_depth_x10(sidx, val));
+                    }
+                    // Hysteresis: release threshold is precomputed per layer table
+                    uint16_t release_thr = act_table->release[sidx];
                     if (prev_pressed[sid]) {
                         // stay pressed until value rises above release_thr
                         if (val <= release_thr) cur_pressed[sid] = true;
@@ -1075,10 +1848,24 @@ int main() {
                         // not pressed: press when below thr
                         if (val < thr) cur_pressed[sid] = true;
                     }
+                    // Deep stage only counts while the primary stage is held
+                    if (cur_pressed[sid]) {
+                        cur_deep[sid] = two_stage_evaluate(sidx, val, prev_deep[sid]);
+                    }
+                    // Stamp transitions with their sample time (latency histogram)
+                    if (cur_pressed[sid] != prev_pressed[sid] || cur_deep[sid] != prev_deep[sid]) {
+                        latency_mark(mux_time_us[s]);
+                    }
                 }
             }
         }
         
+        // Full-frame snapshot: every value above came from this one scan pass
+        if (adc_snapshot_wanted()) {
+            adc_snapshot_capture(adc_cached_values, mux_time_us[0]);
+        }
+        adc_snapshot_task();
+
         // ADC streaming (Shego-style): stream small batches and cycle through keys.
         // This keeps USB traffic bounded and ensures every key eventually updates.
         {
@@ -1138,7 +1925,7 @@ int main() {
 
         bool changed = false;
         for (int i = 1; i <= SENSOR_COUNT; i++) {
-            if (cur_pressed[i] != prev_pressed[i]) { changed = true; break; }
+            if (cur_pressed[i] != prev_pressed[i] || cur_deep[i] != prev_deep[i]) { changed = true; break; }
         }
 
         // ========== LAYER HANDLING (MO/TG, like Saturn60/VLT) ==========
@@ -1149,6 +1936,7 @@ int main() {
             bool pressed = cur_pressed[i];
             bool was_pressed = prev_pressed[i];
             if (pressed == was_pressed) continue;
+            if (pressed) lighting_notify_keypress((uint8_t)(i - 1));
 
             uint8_t kc = get_keycode(current_layer, i - 1);
 
@@ -1207,20 +1995,14 @@ int main() {
             hid_set_status_flags(status_flags, current_layer);
         }
 
-        // Update key states for HID preview feature
-        // Convert cur_pressed array (1-indexed) to 0-indexed bool array
-        bool key_states_0idx[SENSOR_COUNT];
-        for (int i = 0; i < SENSOR_COUNT; i++) {
-            key_states_0idx[i] = cur_pressed[i + 1];
-        }
-        hid_set_key_states(key_states_0idx, SENSOR_COUNT);
-
         if (changed) {
-            // Build the key report using keycode-based detection (not hardcoded sensor IDs)
-            // This respects layer remapping — a key remapped from modifier to regular works correctly
-            uint8_t keys[6] = {0};
-            uint8_t modifiers = 0;
-            int ki = 0;
+            // Convert cur_pressed array (1-indexed) to 0-indexed bool array
+            bool key_states_0idx[SENSOR_COUNT];
+            for (int i = 0; i < SENSOR_COUNT; i++) {
+                key_states_0idx[i] = cur_pressed[i + 1];
+            }
+            // Key preview / events see the physical state, before SOCD
+            notify_set_key_states(key_states_0idx, SENSOR_COUNT);
 
             // Apply SOCD resolution — modifies key_states_0idx in place
             // The pair-based system resolves any configured opposing-key pairs
@@ -1228,94 +2010,38 @@ int main() {
                 socd_process_keys(key_states_0idx, SENSOR_COUNT);
             }
 
-            // Track active consumer key to send only on state change
-            static uint16_t active_consumer_usage = 0;
-            uint16_t new_consumer_usage = 0;
-
+            // Turn resolved state differences into key events. Only keys that
+            // transitioned touch the report; MO/TG keys produce no events.
+            static bool out_pressed[SENSOR_COUNT] = {0};
+            static bool out_deep[SENSOR_COUNT] = {0};
             for (int i = 0; i < SENSOR_COUNT; i++) {
-                if (!key_states_0idx[i]) continue;
-
-                uint8_t hidk = get_keycode(current_layer, i);
-                if (hidk == 0) continue;
-
-                // Skip MO/TG layer keys (handled in layer section above)
-                if (is_mo_keycode(hidk) || is_tg_keycode(hidk)) continue;
-
-                // Modifier keys → set modifier bits
-                if (is_modifier_keycode(hidk)) {
-                    modifiers |= get_modifier_bit(hidk);
-                    continue;
-                }
-
-                // Consumer control keys
-                uint16_t consumer_usage = 0;
-                if (keycode_to_consumer_usage(hidk, &consumer_usage)) {
-                    if (new_consumer_usage == 0) new_consumer_usage = consumer_usage;
-                    continue;
-                }
-
-                // Custom keycodes — fire on press edge only
-                if (!prev_pressed[i + 1]) {
-                    if (hidk == KC_BOOTLOADER) {
-                        printf("Keycode: entering bootloader...\n");
-                        hid_release_all_keys();
-                        sleep_ms(150);
-                        led_power_set(false);
-                        sleep_ms(50);
-                        reset_usb_boot(0, 0);
-                    }
-                    if (hidk == KC_REBOOT) {
-                        printf("Keycode: rebooting...\n");
-                        hid_release_all_keys();
-                        sleep_ms(150);
-                        led_power_set(false);
-                        sleep_ms(50);
-                        watchdog_reboot(0, 0, 100);
-                    }
-                    if (hidk == KC_CALIBRATE) {
-                        printf("Keycode: recalibrating...\n");
-                        mcp3208_hallscan_calibrate();
-                    }
-                    if (hidk == KC_LED_TOG) {
-                        leds_enabled = !leds_enabled;
-                        led_power_set(leds_enabled);
-                        printf("Keycode: LED toggle -> %s\n", leds_enabled ? "ON" : "OFF");
-                    }
-                    if (hidk == KC_SOCD_TOG) {
-                        socd_toggle();
-                        lighting_socd_animation(socd_get_enabled());
-                        printf("Keycode: SOCD toggle -> %s\n", socd_get_enabled() ? "ON" : "OFF");
-                    }
-                }
+                const bool down = key_states_0idx[i];
+                const bool deep = down && cur_deep[i + 1];
+                if (down == out_pressed[i] && deep == out_deep[i]) continue;
 
-                // Skip non-HID keycodes from the report
-                if (hidk == KC_BOOTLOADER || hidk == KC_REBOOT ||
-                    hidk == KC_CALIBRATE || hidk == KC_LED_TOG || hidk == KC_SOCD_TOG) continue;
+                // Press: primary first, then deep. Release: deep first.
+                if (down && !out_pressed[i]) key_primary_event((uint8_t)i, true, current_layer);
+                if (deep != out_deep[i]) key_deep_event((uint8_t)i, deep, current_layer);
+                if (!down && out_pressed[i]) key_primary_event((uint8_t)i, false, current_layer);
 
-                // Regular HID key
-                if (ki < 6) keys[ki++] = hidk;
+                out_pressed[i] = down;
+                out_deep[i] = deep;
             }
+        }
 
-            // Only send consumer report on state change
-            if (new_consumer_usage != active_consumer_usage) {
-                active_consumer_usage = new_consumer_usage;
-                if (tud_hid_n_ready(0)) {
-                    tud_hid_n_report(0, 2, &active_consumer_usage, sizeof(active_consumer_usage));
-                }
-            }
+        // Send only when the encoded state differs from what the host has.
+        // Retried every pass, so a busy endpoint delays a report instead of losing it.
+        keyboard_report_send();
+        consumer_report_task();
+        mouse_task();
+        sof_align_scan_done();
+        notify_task();
 
-            // Send keyboard report over USB
-            if (tud_hid_n_ready(0)) {
-                uint8_t kbd_report[8];
-                kbd_report[0] = modifiers;
-                kbd_report[1] = 0;
-                memcpy(&kbd_report[2], keys, 6);
-                tud_hid_n_report(0, 1, kbd_report, sizeof(kbd_report));
-            }
+        for (int i = 1; i <= SENSOR_COUNT; i++) {
+            prev_pressed[i] = cur_pressed[i];
+            prev_deep[i] = cur_deep[i];
         }
 
-        for (int i = 1; i <= SENSOR_COUNT; i++) prev_pressed[i] = cur_pressed[i];
-
         for (uint8_t mux_idx = 0; mux_idx < MUX_COUNT; mux_idx++) {
             int n = snprintf(outbuf + off, left, "MUX %u =", (unsigned)(mux_idx + 1));
             if (n < 0) n = 0;
@@ -1351,13 +2077,8 @@ int main() {
 #endif
         }
         
-        // Update animated LED effects (only if LEDs are enabled)
-        if (leds_enabled) {
-            lighting_update();
-        }
-        
         // small pause between full scans
-        sleep_ms(SCAN_DELAY_MS);
+        if (scan_delay_allowed()) sleep_ms(SCAN_DELAY_MS);
 
         // keep loop cooperative for USB
         sleep_ms(0);
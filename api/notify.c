@@ -0,0 +1,128 @@
+#include "notify.h"
+#include "hid_reports.h"
+#include "hid_queue.h"
+#include "profiles.h"
+#include "usb_descriptors.h"
+#include "tusb.h"
+#include <string.h>
+
+// Everything here runs in main loop context (scan, and hid_raw_receive via
+// tud_task), so no locking is needed.
+
+static uint8_t sub_mask = 0;
+static uint8_t sub_instance = 0;
+static uint8_t stale = 0;     // subscribed classes owed their full state
+
+static uint8_t key_bits[NOTIFY_KEY_BYTES];
+static uint8_t status_flags = 0;
+static uint8_t layer = 0;
+
+// State the host was last told
+static uint8_t sent_key_bits[NOTIFY_KEY_BYTES];
+static uint8_t sent_status = 0;
+static uint8_t sent_layer = 0;
+static uint8_t sent_profile = 0;
+
+void notify_init(void)
+{
+    memset(key_bits, 0, sizeof(key_bits));
+    status_flags = 0;
+    layer = 0;
+    notify_reset();
+}
+
+void notify_reset(void)
+{
+    sub_mask = 0;
+    stale = 0;
+}
+
+void notify_subscribe(uint8_t instance, uint8_t mask)
+{
+    sub_mask = mask & NOTIFY_ALL;
+    sub_instance = instance;
+    // (Re)subscribing resynchronizes the host
+    stale = sub_mask;
+}
+
+uint8_t notify_get_mask(void)
+{
+    return sub_mask;
+}
+
+void notify_set_key_states(const bool *states, size_t count)
+{
+    if (count > SENSOR_COUNT) count = SENSOR_COUNT;
+    memset(key_bits, 0, sizeof(key_bits));
+    for (size_t i = 0; i < count; i++) {
+        if (states[i]) key_bits[i / 8] |= (uint8_t)(1u << (i % 8));
+    }
+}
+
+void notify_get_key_bits(uint8_t *out)
+{
+    if (out) memcpy(out, key_bits, sizeof(key_bits));
+}
+
+void notify_set_status(uint8_t flags, uint8_t new_layer)
+{
+    status_flags = flags;
+    layer = new_layer;
+}
+
+// Append one [class, len, payload] record
+static uint8_t put_record(uint8_t *resp, uint8_t pos, uint8_t cls, const uint8_t *payload, uint8_t len)
+{
+    resp[pos++] = cls;
+    resp[pos++] = len;
+    memcpy(&resp[pos], payload, len);
+    return (uint8_t)(pos + len);
+}
+
+void notify_task(void)
+{
+    if (sub_mask == 0 || !tud_mounted()) return;
+    // Never queue behind command responses; changes meanwhile fold into one event
+    if (hid_queue_pending(sub_instance) || !tud_hid_n_ready(sub_instance)) return;
+
+    const uint8_t profile = profiles_get_current_slot();
+    uint8_t resp[64] = {0};
+    uint8_t pos = 1;
+    resp[0] = RESP_EVENT;
+
+    if (sub_mask & NOTIFY_KEYS) {
+        uint8_t first = NOTIFY_KEY_BYTES;
+        uint8_t last = 0;
+        for (uint8_t i = 0; i < NOTIFY_KEY_BYTES; i++) {
+            if ((stale & NOTIFY_KEYS) || key_bits[i] != sent_key_bits[i]) {
+                if (first == NOTIFY_KEY_BYTES) first = i;
+                last = i;
+            }
+        }
+        if (first < NOTIFY_KEY_BYTES) {
+            uint8_t span[1 + NOTIFY_KEY_BYTES];
+            const uint8_t n = (uint8_t)(last - first + 1);
+            span[0] = first;
+            memcpy(&span[1], &key_bits[first], n);
+            pos = put_record(resp, pos, NOTIFY_KEYS, span, (uint8_t)(1 + n));
+        }
+    }
+    if ((sub_mask & NOTIFY_LAYER) && ((stale & NOTIFY_LAYER) || layer != sent_layer)) {
+        pos = put_record(resp, pos, NOTIFY_LAYER, &layer, 1);
+    }
+    if ((sub_mask & NOTIFY_PROFILE) && ((stale & NOTIFY_PROFILE) || profile != sent_profile)) {
+        pos = put_record(resp, pos, NOTIFY_PROFILE, &profile, 1);
+    }
+    if ((sub_mask & NOTIFY_STATUS) && ((stale & NOTIFY_STATUS) || status_flags != sent_status)) {
+        pos = put_record(resp, pos, NOTIFY_STATUS, &status_flags, 1);
+    }
+    if (pos == 1) return;
+
+    if (!hid_queue_send(sub_instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE)) return;
+
+    memcpy(sent_key_bits, key_bits, sizeof(sent_key_bits));
+    sent_layer = layer;
+    sent_profile = profile;
+    sent_status = status_flags;
+    stale = 0;
+}
@@ -0,0 +1,51 @@
+#ifndef NOTIFY_H
+#define NOTIFY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hallscan_config.h"
+
+// State change events pushed to the host instead of polled. The host
+// subscribes to event classes (CMD_SET_EVENTS); from then on the firmware
+// sends RESP_EVENT on the subscribing interface whenever a subscribed value
+// differs from what the host was last told. A change that cannot go out
+// because the interface is busy is folded into the next event, so the host
+// always ends up with the latest state. Subscribing sends the full current
+// state of the new classes once.
+//
+// Report: [RESP_EVENT, records...] with records [class, len, payload...],
+// terminated by class 0:
+//   NOTIFY_KEYS     [first_byte, bits...]  key bitmap bytes first_byte..,
+//                   LSB = lowest key; only the span that changed is sent
+//   NOTIFY_LAYER    [layer]
+//   NOTIFY_PROFILE  [keymap_profile]
+//   NOTIFY_STATUS   [flags]  bit0 = LED power, bit1 = SOCD (as RESP_STATUS)
+
+#define NOTIFY_KEYS     0x01
+#define NOTIFY_LAYER    0x02
+#define NOTIFY_PROFILE  0x04
+#define NOTIFY_STATUS   0x08
+#define NOTIFY_ALL      (NOTIFY_KEYS | NOTIFY_LAYER | NOTIFY_PROFILE | NOTIFY_STATUS)
+
+#define NOTIFY_KEY_BYTES ((SENSOR_COUNT + 7) / 8)
+
+void notify_init(void);
+
+// Drop the subscription (new host session)
+void notify_reset(void);
+
+// Subscribe instance to the classes in mask (0 = unsubscribe)
+void notify_subscribe(uint8_t instance, uint8_t mask);
+uint8_t notify_get_mask(void);
+
+// Scan loop: physical key states (0-indexed). Call only when they changed.
+void notify_set_key_states(const bool *states, size_t count);
+void notify_get_key_bits(uint8_t *out);   // NOTIFY_KEY_BYTES
+
+void notify_set_status(uint8_t flags, uint8_t layer);
+
+// Send pending events if the interface is idle. Call every loop.
+void notify_task(void);
+
+#endif // NOTIFY_H
@@ -9,6 +9,7 @@
 #include "hardware/sync.h"
 
 #include "hallscan_config.h"
+#include "lighting.h"
 
 #ifndef MAX_LAYERS
 #define MAX_LAYERS 4
@@ -56,6 +57,13 @@ static bool g_static_indicator = false;
 static uint8_t g_keymaps[PROFILE_COUNT][MAX_LAYERS][SENSOR_COUNT];
 static bool g_dirty = false;
 
+// Staging for flash writes and host images, padded to whole flash pages.
+// Several KB, so kept off core0's stack. Main loop only.
+static union {
+    profiles_flash_t block;
+    uint8_t bytes[PROFILES_PROGRAM_SIZE];
+} g_stage;
+
 static uint32_t profiles_checksum(const profiles_flash_t *p)
 {
     const uint8_t *b = (const uint8_t *)p;
@@ -66,41 +74,48 @@ static uint32_t profiles_checksum(const profiles_flash_t *p)
     return sum;
 }
 
-static void profiles_flush_to_flash(void)
+static void profiles_build(profiles_flash_t *out)
 {
-    profiles_flash_t out;
-    memset(&out, 0, sizeof(out));
-    out.magic = PROFILES_MAGIC;
-    out.version = PROFILES_VERSION;
-    out.current_slot = g_current_slot;
-    out.valid_mask = (uint16_t)(g_valid_mask | 0x0001);
-    memcpy(out.colors, g_colors, sizeof(g_colors));
-    out.static_indicator_enabled = g_static_indicator ? 1 : 0;
-    memcpy(out.keymaps, g_keymaps, sizeof(g_keymaps));
-    out.checksum = profiles_checksum(&out);
+    memset(out, 0, sizeof(*out));
+    out->magic = PROFILES_MAGIC;
+    out->version = PROFILES_VERSION;
+    out->current_slot = g_current_slot;
+    out->valid_mask = (uint16_t)(g_valid_mask | 0x0001);
+    memcpy(out->colors, g_colors, sizeof(g_colors));
+    out->static_indicator_enabled = g_static_indicator ? 1 : 0;
+    memcpy(out->keymaps, g_keymaps, sizeof(g_keymaps));
+    out->checksum = profiles_checksum(out);
+}
 
+static void profiles_flush_to_flash(void)
+{
     // flash_range_program requires FLASH_PAGE_SIZE alignment for length.
-    uint8_t program_buf[PROFILES_PROGRAM_SIZE];
-    memset(program_buf, 0xFF, sizeof(program_buf));
-    memcpy(program_buf, &out, sizeof(out));
+    memset(g_stage.bytes, 0xFF, sizeof(g_stage.bytes));
+    profiles_build(&g_stage.block);
 
+    lighting_flash_lockout_begin();
     uint32_t ints = save_and_disable_interrupts();
     flash_range_erase(PROFILES_FLASH_OFFSET, FLASH_SECTOR_SIZE);
-    flash_range_program(PROFILES_FLASH_OFFSET, program_buf, sizeof(program_buf));
+    flash_range_program(PROFILES_FLASH_OFFSET, g_stage.bytes, sizeof(g_stage.bytes));
     restore_interrupts(ints);
+    lighting_flash_lockout_end();
 
     g_dirty = false;
     printf("[PROFILES] Saved to flash\n");
 }
 
-static bool profiles_load_from_flash(void)
+static bool profiles_valid(const profiles_flash_t *in)
 {
-    const profiles_flash_t *in = (const profiles_flash_t *)PROFILES_FLASH_PTR;
     if (in->magic != PROFILES_MAGIC) return false;
     if (in->version != PROFILES_VERSION) return false;
     const uint32_t got = in->checksum;
     const uint32_t exp = profiles_checksum(in);
-    if (got != exp) return false;
+    return got == exp;
+}
+
+static bool profiles_apply(const profiles_flash_t *in)
+{
+    if (!profiles_valid(in)) return false;
 
     g_current_slot = in->current_slot;
     g_valid_mask = (uint16_t)(in->valid_mask | 0x0001);
@@ -111,6 +126,35 @@ static bool profiles_load_from_flash(void)
     return true;
 }
 
+static bool profiles_load_from_flash(void)
+{
+    return profiles_apply((const profiles_flash_t *)PROFILES_FLASH_PTR);
+}
+
+size_t profiles_export(uint8_t *buf, size_t cap)
+{
+    if (cap < sizeof(profiles_flash_t)) return 0;
+    profiles_build(&g_stage.block);
+    memcpy(buf, &g_stage.block, sizeof(g_stage.block));
+    return sizeof(g_stage.block);
+}
+
+bool profiles_block_valid(const uint8_t *buf, size_t len)
+{
+    if (len != sizeof(profiles_flash_t)) return false;
+    memcpy(&g_stage.block, buf, sizeof(g_stage.block));
+    return profiles_valid(&g_stage.block);
+}
+
+bool profiles_import(const uint8_t *buf, size_t len)
+{
+    // Leaves the block in g_stage
+    if (!profiles_block_valid(buf, len)) return false;
+    if (!profiles_apply(&g_stage.block)) return false;
+    profiles_flush_to_flash();
+    return true;
+}
+
 static bool slot_valid(uint8_t slot)
 {
     if (slot >= PROFILE_COUNT) return false;
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stddef.h>
 
 // Simple keymap profile storage for taki_mina to match the app's 0x70+ protocol.
 // Slots: 0..9 (0 is base/default and always valid)
@@ -26,4 +27,10 @@ bool profiles_set_slot_color(uint8_t slot, uint8_t r, uint8_t g, uint8_t b);
 bool profiles_static_indicator_enabled(void);
 bool profiles_set_static_indicator(bool enabled);
 
+// Raw storage block for the configuration image (config_image.c).
+// Import validates the block and writes it to flash once.
+size_t profiles_export(uint8_t *buf, size_t cap);
+bool profiles_block_valid(const uint8_t *buf, size_t len);
+bool profiles_import(const uint8_t *buf, size_t len);
+
 #endif // PROFILES_H
@@ -0,0 +1,128 @@
+#include "raw_tx.h"
+#include "hid_queue.h"
+#include "hid_reports.h"
+#include "usb_descriptors.h"
+#include "tusb.h"
+#include <string.h>
+
+// Runs in tud_task() / main loop context only (see hid_queue.c).
+
+typedef struct {
+    raw_tx_job_t jobs[RAW_TX_JOB_DEPTH];
+    uint8_t head;
+    uint8_t count;
+    // One record generated ahead, so a batch knows whether it is the last
+    uint8_t look[RAW_TX_MAX_RECORD];
+    bool look_valid;
+} raw_tx_queue_t;
+
+static raw_tx_queue_t queues[RAW_TX_INSTANCES];
+static bool batching = false;
+
+static bool fetch(raw_tx_queue_t *q, raw_tx_job_t *job, uint8_t *record)
+{
+    if (q->look_valid) {
+        memcpy(record, q->look, job->record_len);
+        q->look_valid = false;
+        return true;
+    }
+    memset(record, 0, job->record_len);
+    return job->next(job, record);
+}
+
+static void finish_job(raw_tx_queue_t *q)
+{
+    q->head = (uint8_t)((q->head + 1) % RAW_TX_JOB_DEPTH);
+    q->count--;
+    q->look_valid = false;
+}
+
+// Fill the next report of the active job. Only called while the interface
+// has nothing queued, so the report goes straight to the endpoint.
+static void refill(uint8_t instance)
+{
+    raw_tx_queue_t *q = &queues[instance];
+
+    while (q->count > 0) {
+        if (hid_queue_pending(instance) || !tud_hid_n_ready(instance)) return;
+
+        raw_tx_job_t *job = &q->jobs[q->head];
+        uint8_t resp[64] = {0};
+        const uint8_t payload = sizeof(resp) - RAW_TX_BATCH_HEADER_LEN;
+
+        if (batching && job->record_len <= payload) {
+            const uint8_t per_report = payload / job->record_len;
+            uint8_t n = 0;
+            bool last = false;
+            while (n < per_report) {
+                if (!fetch(q, job, &resp[RAW_TX_BATCH_HEADER_LEN + n * job->record_len])) {
+                    last = true;
+                    break;
+                }
+                n++;
+            }
+            if (!last) {
+                memset(q->look, 0, job->record_len);
+                q->look_valid = job->next(job, q->look);
+                last = !q->look_valid;
+            }
+            resp[0] = RESP_BATCH;
+            resp[1] = job->resp_code;
+            resp[2] = job->record_len;
+            resp[3] = n;
+            resp[4] = last ? RAW_TX_BATCH_FLAG_LAST : 0;
+            hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+            if (last) finish_job(q);
+            return;
+        }
+
+        // Legacy: one record per report
+        if (!fetch(q, job, &resp[1])) {
+            finish_job(q);
+            continue;
+        }
+        resp[0] = job->resp_code;
+        hid_queue_send(instance, REPORT_ID_RAW, resp, sizeof(resp), HID_QUEUE_FLAG_NONE);
+        return;
+    }
+}
+
+void raw_tx_init(void)
+{
+    memset(queues, 0, sizeof(queues));
+    for (uint8_t i = 0; i < RAW_TX_INSTANCES; i++) {
+        if (i == ITF_NUM_HID_KBD) continue;
+        hid_queue_add_idle_handler(i, refill);
+    }
+}
+
+bool raw_tx_start(uint8_t instance, const raw_tx_job_t *job)
+{
+    if (instance >= RAW_TX_INSTANCES || instance == ITF_NUM_HID_KBD) return false;
+    if (!job || !job->next || job->record_len == 0 || job->record_len > RAW_TX_MAX_RECORD) return false;
+
+    raw_tx_queue_t *q = &queues[instance];
+    if (q->count >= RAW_TX_JOB_DEPTH) return false;
+    q->jobs[(q->head + q->count) % RAW_TX_JOB_DEPTH] = *job;
+    q->count++;
+
+    refill(instance);
+    return true;
+}
+
+void raw_tx_task(void)
+{
+    for (uint8_t i = 0; i < RAW_TX_INSTANCES; i++) {
+        if (queues[i].count > 0) refill(i);
+    }
+}
+
+void raw_tx_set_batching(bool enabled)
+{
+    batching = enabled;
+}
+
+bool raw_tx_get_batching(void)
+{
+    return batching;
+}
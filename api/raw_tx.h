@@ -0,0 +1,52 @@
+#ifndef RAW_TX_H
+#define RAW_TX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Multi-record raw HID responses (modified keys, SOCD pairs, profile list,
+// keymap chunks). A request starts a job on the interface it arrived on;
+// records are generated only when the endpoint is free, refilled from the
+// report-complete callback, so nothing is dropped when the host is slow.
+//
+// Legacy hosts get one record per report, exactly as before. Hosts that opt
+// in with CMD_SET_RAW_BATCHING get as many records per report as fit:
+//   [RESP_BATCH, record_code, record_len, count, flags, records...]
+//   flags bit0: last report of this response
+
+#define RAW_TX_INSTANCES   4       // same numbering as the HID interfaces
+#ifndef RAW_TX_JOB_DEPTH
+#define RAW_TX_JOB_DEPTH   4       // pending responses per interface
+#endif
+#define RAW_TX_MAX_RECORD  63      // record bytes after the response code
+
+#define RAW_TX_BATCH_HEADER_LEN 5
+#define RAW_TX_BATCH_FLAG_LAST  0x01
+
+typedef struct raw_tx_job raw_tx_job_t;
+
+// Write the next record (record_len bytes, zero-filled by the caller) and
+// return true, or return false when the response is complete.
+typedef bool (*raw_tx_next_fn)(raw_tx_job_t *job, uint8_t *record);
+
+struct raw_tx_job {
+    uint8_t resp_code;    // response code of each record (legacy report byte 0)
+    uint8_t record_len;   // bytes per record; records over one batch payload always go one per report
+    uint8_t arg;          // generator argument (e.g. layer)
+    uint16_t cursor;      // generator position
+    raw_tx_next_fn next;
+};
+
+void raw_tx_init(void);
+
+// Queue a response job. Returns false if the interface already has
+// RAW_TX_JOB_DEPTH responses waiting.
+bool raw_tx_start(uint8_t instance, const raw_tx_job_t *job);
+
+// Refill idle interfaces (call from the main loop)
+void raw_tx_task(void);
+
+void raw_tx_set_batching(bool enabled);
+bool raw_tx_get_batching(void);
+
+#endif // RAW_TX_H
@@ -0,0 +1,166 @@
+#include "sof_align.h"
+#include "hallscan_config.h"
+#include "tusb.h"
+#include "pico/time.h"
+
+#define FRAME_US        1000u
+#define SOF_TIMEOUT_US  3000u   // no SOF for this long = host not polling
+#define SOF_CREEP_US    2u      // per frame, follows host/device clock drift
+#define SOF_FRAME_MASK  0x7FFu  // 11-bit USB frame number
+
+// SOF phase: tud_sof_cb() runs from tud_task(), so each call is late by
+// however long the loop took to get there. SOFs sit on a 1 ms grid counted
+// by the frame number, so the estimate follows the earliest call on that
+// grid: an earlier call moves it back at once, a later one only nudges it
+// forward by SOF_CREEP_US. Does not depend on interrupt handler order.
+static uint32_t sof_time_us = 0;    // estimated time of the latest SOF
+static uint32_t sof_seen_us = 0;    // time of the latest callback
+static uint32_t sof_frame = 0;
+static uint32_t sof_count = 0;
+
+static bool enabled = SOF_ALIGN_ENABLE;
+static uint16_t margin_us = SOF_ALIGN_MARGIN_US;
+
+// Per-scan state
+static bool target_valid = false;
+static uint32_t target_sof_us = 0;
+static uint32_t scan_start_us = 0;
+
+// Measurements (x16 fixed point for the averages)
+static uint32_t scan_peak_us = 0;
+static uint32_t last_start_us = 0;
+static bool last_start_valid = false;
+static int32_t period_avg_x16 = 0;
+static int32_t lead_avg_x16 = 0;
+static uint32_t lead_jitter_x16 = 0;
+static uint32_t missed = 0;
+
+void tud_sof_cb(uint32_t frame_count)
+{
+    const uint32_t now = time_us_32();
+    const uint32_t frames = (frame_count - sof_frame) & SOF_FRAME_MASK;
+    const bool resync = sof_count == 0 || (now - sof_seen_us) >= SOF_TIMEOUT_US;
+    sof_frame = frame_count;
+    sof_seen_us = now;
+    sof_count++;
+
+    if (resync) {
+        sof_time_us = now;
+        return;
+    }
+    if (frames == 0) return;
+    const uint32_t predicted = sof_time_us + frames * FRAME_US;
+    const int32_t late = (int32_t)(now - predicted);
+    if (late < 0) sof_time_us = now;
+    else sof_time_us = predicted + ((uint32_t)late < SOF_CREEP_US ? (uint32_t)late : SOF_CREEP_US);
+}
+
+void sof_align_init(void)
+{
+    // TinyUSB only takes SOF interrupts while someone asks for them
+    tud_sof_cb_enable(enabled);
+}
+
+void sof_align_set(bool en, uint16_t margin)
+{
+    enabled = en;
+    if (margin >= FRAME_US) margin = FRAME_US - 1;
+    margin_us = margin;
+    target_valid = false;
+    missed = 0;
+    tud_sof_cb_enable(enabled);
+}
+
+static bool sof_locked(uint32_t now)
+{
+    return sof_count != 0 && (now - sof_seen_us) < SOF_TIMEOUT_US;
+}
+
+void sof_align_get_stats(sof_align_stats_t *out)
+{
+    if (!out) return;
+    out->enabled = enabled;
+    out->locked = enabled && sof_locked(time_us_32());
+    out->margin_us = margin_us;
+    out->scan_us = (uint16_t)(scan_peak_us > 0xFFFF ? 0xFFFF : scan_peak_us);
+    out->period_us = (uint16_t)(period_avg_x16 / 16);
+    out->lead_avg_us = (int16_t)(lead_avg_x16 / 16);
+    out->lead_jitter_us = (uint16_t)(lead_jitter_x16 / 16);
+    out->frames = sof_count;
+    out->missed = missed;
+}
+
+bool sof_align_active(void)
+{
+    return enabled && tud_mounted() && sof_locked(time_us_32());
+}
+
+// Scan period, measured whether or not alignment is on
+static void scan_started(uint32_t now)
+{
+    scan_start_us = now;
+    if (last_start_valid) {
+        uint32_t period = now - last_start_us;
+        if (period > 0xFFFF) period = 0xFFFF;
+        period_avg_x16 += ((int32_t)period * 16 - period_avg_x16) / 16;
+    }
+    last_start_us = now;
+    last_start_valid = true;
+}
+
+void sof_align_wait(void)
+{
+    target_valid = false;
+    const uint32_t now = time_us_32();
+    if (!enabled || !tud_mounted() || !sof_locked(now)) {
+        scan_started(now);
+        return;
+    }
+
+    // Scan + margin must fit in a frame, otherwise there is nothing to align
+    const uint32_t budget = scan_peak_us + margin_us;
+    if (budget >= FRAME_US) {
+        scan_started(now);
+        return;
+    }
+
+    uint32_t next_sof = sof_time_us + FRAME_US;
+    while ((int32_t)(next_sof - now) <= 0) next_sof += FRAME_US;
+    uint32_t start = next_sof - budget;
+    if ((int32_t)(start - now) < 0) {
+        // Too late for this frame: finish just before the following one
+        next_sof += FRAME_US;
+        start += FRAME_US;
+    }
+
+    // Keep USB serviced while holding off the scan
+    while ((int32_t)(start - time_us_32()) > 0) {
+        tud_task();
+    }
+
+    target_sof_us = next_sof;
+    scan_started(time_us_32());
+    target_valid = true;
+}
+
+void sof_align_scan_done(void)
+{
+    if (!enabled) return;
+    const uint32_t now = time_us_32();
+
+    // Budget tracks the slowest recent scan, decaying slowly toward the current one
+    const uint32_t dur = now - scan_start_us;
+    if (dur > scan_peak_us) scan_peak_us = dur;
+    else scan_peak_us -= (scan_peak_us - dur) / 64;
+
+    if (!target_valid) return;
+    target_valid = false;
+
+    const int32_t lead = (int32_t)(target_sof_us - now);
+    if (lead < 0) missed++;
+
+    lead_avg_x16 += (lead * 16 - lead_avg_x16) / 16;
+    int32_t dev = lead * 16 - lead_avg_x16;
+    if (dev < 0) dev = -dev;
+    lead_jitter_x16 += ((uint32_t)dev - lead_jitter_x16) / 16;
+}
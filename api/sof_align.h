@@ -0,0 +1,46 @@
+#ifndef SOF_ALIGN_H
+#define SOF_ALIGN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Phase-locks the scan to USB start-of-frame. SOFs are timestamped from
+// tud_sof_cb(), and the main loop holds off the next scan so it finishes, and
+// its report is queued, SOF_ALIGN_MARGIN_US before the next frame starts.
+// The report then goes out on that frame's first IN poll instead of waiting
+// a random fraction of a frame.
+//
+// While aligned, the wait replaces the main loop's fixed pause between scans,
+// so every scan is aligned, not just the ones that happen to follow a pause.
+//
+// Costs: at most one scan per USB frame while aligned.
+
+typedef struct {
+    bool enabled;
+    bool locked;          // SOFs are arriving (host is polling)
+    uint16_t margin_us;   // target: report queued this long before SOF
+    uint16_t scan_us;     // scan duration budget (decaying peak)
+    uint16_t period_us;   // measured time between scan starts (average)
+    int16_t lead_avg_us;  // measured: SOF time minus report-queued time
+    uint16_t lead_jitter_us;  // mean absolute deviation of the lead
+    uint32_t frames;      // SOFs seen
+    uint32_t missed;      // scans that finished after their target SOF
+} sof_align_stats_t;
+
+void sof_align_init(void);    // after tusb_init()
+
+void sof_align_set(bool enabled, uint16_t margin_us);
+void sof_align_get_stats(sof_align_stats_t *out);
+
+// True while scans are being phase-locked (enabled, mounted, SOFs arriving).
+// The main loop then skips its fixed pause and lets sof_align_wait() pace it.
+bool sof_align_active(void);
+
+// Wait (servicing USB) until the scan should start. No-op when disabled
+// or when no SOFs are arriving.
+void sof_align_wait(void);
+
+// The scan's report has been queued
+void sof_align_scan_done(void);
+
+#endif // SOF_ALIGN_H
@@ -76,18 +76,25 @@
 #define CFG_TUD_ENDPOINT0_SIZE    64
 #endif
 
+// Board feature flags (MIDI_ENABLE etc.)
+#include "hallscan_config.h"
+
 //------------- CLASS -------------//
 // Four HID interfaces: keyboard + VIA raw + app raw + response raw (same as Shego)
 #define CFG_TUD_HID               4
 #define CFG_TUD_CDC               0
 #define CFG_TUD_MSC               0
-#define CFG_TUD_MIDI              0
+#define CFG_TUD_MIDI              MIDI_ENABLE
 #define CFG_TUD_VENDOR            0
 
 // HID buffer size Should be sufficient to hold ID (if any) + Data
 // We need 64-byte reports for raw HID control
 #define CFG_TUD_HID_EP_BUFSIZE    64
 
+// MIDI FIFO sizes (one full-speed packet each way)
+#define CFG_TUD_MIDI_RX_BUFSIZE   64
+#define CFG_TUD_MIDI_TX_BUFSIZE   64
+
 #ifdef __cplusplus
  }
 #endif
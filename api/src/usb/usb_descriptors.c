@@ -2,11 +2,17 @@
  * Matches Shego75 4-interface structure for reliable bidirectional HID
  */
 #include "tusb.h"
+#include "hallscan_config.h"
+#include "consumer_report.h"
 #include <string.h>
 
-// Vendor/Product IDs - Mina65
+// Vendor/Product IDs - Mina65 (config.h values win when defined)
+#ifndef USB_VID
 #define USB_VID 0xDEAD
+#endif
+#ifndef USB_PID
 #define USB_PID 0xFADE
+#endif
 
 // String descriptors
 const char* string_desc_arr[] = {
@@ -71,19 +77,90 @@ const uint8_t hid_report_desc_kbd[] = {
 	0x81, 0x00,       //   Input (Data,Array) - Key array
 	0xC0,             // End Collection
 
-	// Report ID 2: Consumer Control (for volume/mute/media)
+	// Report ID 2: Consumer Control (volume/media/AL/AC), several usages at once
 	0x05, 0x0C,       // Usage Page (Consumer)
 	0x09, 0x01,       // Usage (Consumer Control)
 	0xA1, 0x01,       // Collection (Application)
 	0x85, 0x02,       //   Report ID (2)
 	0x15, 0x00,       //   Logical Minimum (0)
-	0x26, 0xFF, 0x03, //   Logical Maximum (1023)
+	0x26, 0xFF, 0x0F, //   Logical Maximum (4095)
 	0x19, 0x00,       //   Usage Minimum (0)
-	0x2A, 0xFF, 0x03, //   Usage Maximum (1023)
+	0x2A, 0xFF, 0x0F, //   Usage Maximum (4095)
 	0x75, 0x10,       //   Report Size (16)
-	0x95, 0x01,       //   Report Count (1)
+	0x95, CONSUMER_REPORT_USAGES, // Report Count
 	0x81, 0x00,       //   Input (Data,Array)
-	0xC0              // End Collection
+	0xC0,             // End Collection
+
+	// Report ID 5: System Control (power down, sleep, wake up)
+	0x05, 0x01,       // Usage Page (Generic Desktop)
+	0x09, 0x80,       // Usage (System Control)
+	0xA1, 0x01,       // Collection (Application)
+	0x85, 0x05,       //   Report ID (5)
+	0x19, 0x81,       //   Usage Minimum (System Power Down)
+	0x29, 0x83,       //   Usage Maximum (System Wake Up)
+	0x16, 0x81, 0x00, //   Logical Minimum (0x81)
+	0x26, 0x83, 0x00, //   Logical Maximum (0x83)
+	0x75, 0x08,       //   Report Size (8)
+	0x95, 0x01,       //   Report Count (1)
+	0x81, 0x00,       //   Input (Data,Array) - 0 = none
+	0xC0,             // End Collection
+
+#if NKRO_ENABLE
+	// Report ID 3: NKRO keyboard (modifiers + bitmap of usages 0x00-0xDF)
+	0x05, 0x01,       // Usage Page (Generic Desktop)
+	0x09, 0x06,       // Usage (Keyboard)
+	0xA1, 0x01,       // Collection (Application)
+	0x85, 0x03,       //   Report ID (3)
+	0x05, 0x07,       //   Usage Page (Key Codes)
+	0x19, 0xE0,       //   Usage Minimum (224)
+	0x29, 0xE7,       //   Usage Maximum (231)
+	0x15, 0x00,       //   Logical Minimum (0)
+	0x25, 0x01,       //   Logical Maximum (1)
+	0x75, 0x01,       //   Report Size (1)
+	0x95, 0x08,       //   Report Count (8)
+	0x81, 0x02,       //   Input (Data,Var,Abs) - Modifiers
+	0x19, 0x00,       //   Usage Minimum (0)
+	0x29, 0xDF,       //   Usage Maximum (223)
+	0x95, 0xE0,       //   Report Count (224)
+	0x81, 0x02,       //   Input (Data,Var,Abs) - Key bitmap
+	0xC0,             // End Collection
+#endif
+
+#if MOUSE_ENABLE
+	// Report ID 4: Mouse (5 buttons, relative x/y, wheel, AC pan)
+	0x05, 0x01,       // Usage Page (Generic Desktop)
+	0x09, 0x02,       // Usage (Mouse)
+	0xA1, 0x01,       // Collection (Application)
+	0x85, 0x04,       //   Report ID (4)
+	0x09, 0x01,       //   Usage (Pointer)
+	0xA1, 0x00,       //   Collection (Physical)
+	0x05, 0x09,       //     Usage Page (Button)
+	0x19, 0x01,       //     Usage Minimum (1)
+	0x29, 0x05,       //     Usage Maximum (5)
+	0x15, 0x00,       //     Logical Minimum (0)
+	0x25, 0x01,       //     Logical Maximum (1)
+	0x75, 0x01,       //     Report Size (1)
+	0x95, 0x05,       //     Report Count (5)
+	0x81, 0x02,       //     Input (Data,Var,Abs) - Buttons
+	0x75, 0x03,       //     Report Size (3)
+	0x95, 0x01,       //     Report Count (1)
+	0x81, 0x01,       //     Input (Constant) - Padding
+	0x05, 0x01,       //     Usage Page (Generic Desktop)
+	0x09, 0x30,       //     Usage (X)
+	0x09, 0x31,       //     Usage (Y)
+	0x09, 0x38,       //     Usage (Wheel)
+	0x15, 0x81,       //     Logical Minimum (-127)
+	0x25, 0x7F,       //     Logical Maximum (127)
+	0x75, 0x08,       //     Report Size (8)
+	0x95, 0x03,       //     Report Count (3)
+	0x81, 0x06,       //     Input (Data,Var,Rel) - X, Y, Wheel
+	0x05, 0x0C,       //     Usage Page (Consumer)
+	0x0A, 0x38, 0x02, //     Usage (AC Pan)
+	0x95, 0x01,       //     Report Count (1)
+	0x81, 0x06,       //     Input (Data,Var,Rel) - Pan
+	0xC0,             //   End Collection
+	0xC0,             // End Collection
+#endif
 };
 
 // VIA/SignalRGB Raw HID report descriptor (vendor-defined, 32-byte IN/OUT, no Report ID)
@@ -144,12 +221,26 @@ enum {
 	ITF_NUM_HID_VIA_RAW,
 	ITF_NUM_HID_APP_RAW,
 	ITF_NUM_HID_RESP_RAW,
+#if MIDI_ENABLE
+	ITF_NUM_MIDI,
+	ITF_NUM_MIDI_STREAMING,
+#endif
 	ITF_NUM_TOTAL
 };
 
+// MIDI endpoints (after the four HID endpoint pairs)
+#define EPNUM_MIDI_OUT  0x05
+#define EPNUM_MIDI_IN   0x85
+
+#if MIDI_ENABLE
+#define DESC_MIDI_LEN   TUD_MIDI_DESC_LEN
+#else
+#define DESC_MIDI_LEN   0
+#endif
+
 // Configuration descriptor total length
-// Config + Keyboard (IF+HID+EP) + VIA raw (IF+HID+2EP) + App raw (IF+HID+2EP) + Resp raw (IF+HID+2EP)
-#define DESC_TOTAL_LEN (9 + (9 + 9 + 7) + (9 + 9 + 7 + 7) + (9 + 9 + 7 + 7) + (9 + 9 + 7 + 7))
+// Config + Keyboard (IF+HID+EP) + VIA raw (IF+HID+2EP) + App raw (IF+HID+2EP) + Resp raw (IF+HID+2EP) [+ MIDI]
+#define DESC_TOTAL_LEN (9 + (9 + 9 + 7) + (9 + 9 + 7 + 7) + (9 + 9 + 7 + 7) + (9 + 9 + 7 + 7) + DESC_MIDI_LEN)
 
 uint8_t const desc_configuration[] = {
 	// Configuration Descriptor
@@ -160,7 +251,7 @@ uint8_t const desc_configuration[] = {
 	ITF_NUM_TOTAL,                // bNumInterfaces
 	0x01,                         // bConfigurationValue
 	0x00,                         // iConfiguration
-	0x80,                         // bmAttributes (bus powered)
+	0xA0,                         // bmAttributes (bus powered, remote wakeup)
 	0xFA,                         // bMaxPower (500mA)
 
 	// Interface Descriptor (Keyboard)
@@ -301,7 +392,12 @@ uint8_t const desc_configuration[] = {
 	0x04,                         // bEndpointAddress (OUT endpoint 4)
 	0x03,                         // bmAttributes (Interrupt)
 	0x40, 0x00,                   // wMaxPacketSize (64 bytes)
-	0x01                          // bInterval (1 ms)
+	0x01,                         // bInterval (1 ms)
+
+#if MIDI_ENABLE
+	// MIDI: Audio Control + MIDI Streaming interfaces, bulk OUT/IN (64 bytes)
+	TUD_MIDI_DESCRIPTOR(ITF_NUM_MIDI, 0, EPNUM_MIDI_OUT, EPNUM_MIDI_IN, 64),
+#endif
 };
 
 // TinyUSB callbacks
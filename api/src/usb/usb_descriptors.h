@@ -3,6 +3,8 @@
 #ifndef USB_DESCRIPTORS_H_
 #define USB_DESCRIPTORS_H_
 
+#include "hallscan_config.h"
+
 enum {
     REPORT_ID_KEYBOARD = 1,
     REPORT_ID_RAW = 2,
@@ -12,12 +14,26 @@ enum {
     REPORT_ID_COUNT
 };
 
+// Report IDs on the keyboard interface (ITF_NUM_HID_KBD)
+enum {
+    REPORT_ID_KBD_6KRO = 1,      // 8-byte boot-format keyboard
+    REPORT_ID_KBD_CONSUMER = 2,  // 16-bit consumer usages x CONSUMER_REPORT_USAGES
+    REPORT_ID_KBD_NKRO = 3,      // modifiers + usage bitmap (NKRO_ENABLE)
+    REPORT_ID_KBD_MOUSE = 4,     // buttons, x, y, wheel, pan (MOUSE_ENABLE)
+    REPORT_ID_KBD_SYSTEM = 5,    // system control usage (power, sleep, wake)
+};
+
 // HID interface numbers (4-interface layout: matches Shego)
+// MIDI (Audio Control + MIDI Streaming) follows when MIDI_ENABLE is set.
 enum {
     ITF_NUM_HID_KBD = 0,
     ITF_NUM_HID_VIA_RAW,
     ITF_NUM_HID_APP_RAW,
     ITF_NUM_HID_RESP_RAW,
+#if MIDI_ENABLE
+    ITF_NUM_MIDI,
+    ITF_NUM_MIDI_STREAMING,
+#endif
 };
 
 #endif /* USB_DESCRIPTORS_H_ */
@@ -34,8 +34,12 @@
 // Define to enable, comment out to disable. No value needed.
 #define RGB_ENABLE
 #define CAPS_LOCK_INDICATOR
+#define NKRO_ENABLE
 // #define ENCODER_ENABLE
+// #define MIDI_ENABLE
 // #define DISPLAY_ENABLE
+// #define MOUSE_ENABLE       // analog mouse keys (KC_MS_*, KC_WH_*, KC_BTN*)
+// #define SOF_ALIGN_ENABLE   // finish each scan just before USB start-of-frame
 
 // ============================================================================
 // LED CONFIGURATION